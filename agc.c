@@ -0,0 +1,90 @@
+/** AGC
+ *
+ * Sliding-window quantile sketch and gain smoothing.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "agc.h"
+
+/* Buckets per factor of two in level. */
+#define AGC_SCALE (AGC_BUCKETS / log2f(AGC_LEVEL_MAX / AGC_LEVEL_MIN))
+
+
+bool agc_init(Agc *a, int window, float quantile, float target, float min_gain, float max_gain, float smoothing) {
+	memset(a, 0, sizeof(Agc));
+	a->window = window > 0 ? window : 1;
+	a->quantile = quantile;
+	a->target = target;
+	a->min_gain = min_gain;
+	a->max_gain = max_gain;
+	a->smoothing = smoothing;
+	a->gain = 1;
+	return (a->ring = calloc((size_t) a->window * AGC_BUCKETS, sizeof(uint16_t))) != NULL;
+}
+
+
+static int bucket(float level) {
+	if (!(level > AGC_LEVEL_MIN))
+		return 0;
+	int b = log2f(level / AGC_LEVEL_MIN) * AGC_SCALE;
+	return b < AGC_BUCKETS ? b : AGC_BUCKETS - 1;
+}
+
+
+/** The level below which `quantile` of the window falls, interpolated
+ * on the log scale within its bucket. */
+static float window_quantile(const Agc *a) {
+	float rank = a->quantile * a->total;
+	uint32_t below = 0;
+
+	for (int b = 0; b < AGC_BUCKETS; ++b) {
+		if (a->counts[b] == 0 || below + a->counts[b] < rank) {
+			below += a->counts[b];
+			continue;
+		}
+		float frac = (rank - below) / a->counts[b];
+		return AGC_LEVEL_MIN * exp2f((b + frac) / AGC_SCALE);
+	}
+	return AGC_LEVEL_MAX;
+}
+
+
+/** Add one frame of `n` levels (at most 65535) to the window and return
+ * the gain to apply to it. */
+float agc_update(Agc *a, const float *levels, int n) {
+	uint16_t *row = a->ring + (size_t) a->pos * AGC_BUCKETS;
+
+	if (a->filled == a->window) {
+		for (int b = 0; b < AGC_BUCKETS; ++b) {
+			a->counts[b] -= row[b];
+			a->total -= row[b];
+		}
+	} else {
+		a->filled++;
+	}
+	memset(row, 0, AGC_BUCKETS * sizeof(uint16_t));
+
+	for (int i = 0; i < n; ++i)
+		row[bucket(levels[i])]++;
+	for (int b = 0; b < AGC_BUCKETS; ++b)
+		a->counts[b] += row[b];
+	a->total += n;
+	a->pos = (a->pos + 1) % a->window;
+
+	/* Move towards the wanted gain geometrically, so that raising and
+	 * lowering it take equally long. */
+	a->level = window_quantile(a);
+	float wanted = a->target / a->level;
+	if (wanted < a->min_gain) wanted = a->min_gain;
+	if (wanted > a->max_gain) wanted = a->max_gain;
+	a->gain *= powf(wanted / a->gain, a->smoothing);
+	return a->gain;
+}
+
+
+void agc_free(Agc *a) {
+	free(a->ring);
+	a->ring = NULL;
+}
@@ -0,0 +1,51 @@
+/** AGC
+ *
+ * Automatic gain control for the binned levels, so that quiet rooms still
+ * move the display and loud ones do not saturate it.
+ *
+ * The gain maps a chosen quantile of the recent levels (e.g. the 95th
+ * percentile over the last ten seconds) to a target level. The quantile
+ * comes from a fixed-bucket histogram of the levels on a log scale: each
+ * level costs one bucket increment, and a ring of per-frame bucket counts
+ * lets the oldest frame leave the window in O(buckets), with no sorting.
+ * The gain then moves towards the one the quantile asks for by a fixed
+ * fraction per frame, so it does not pump on single hits.
+ */
+
+#ifndef AGC_H
+#define AGC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AGC_BUCKETS 64         // histogram buckets, log-spaced
+#define AGC_LEVEL_MIN 0.01f    // binned level at the bottom of the lowest bucket
+#define AGC_LEVEL_MAX 100000   // binned level at the top of the highest bucket
+
+
+/* Data structures. */
+typedef struct {
+	int window;            // frames in the sliding window
+	float quantile;        // 0 to 1
+	float target;          // level the quantile is scaled to
+	float min_gain;
+	float max_gain;
+	float smoothing;       // fraction of the way to the new gain per frame
+
+	uint16_t *ring;        // `window` x AGC_BUCKETS counts
+	uint32_t counts[AGC_BUCKETS];  // running sum of the ring
+	uint32_t total;
+	int pos;               // next ring row
+	int filled;            // ring rows in use
+
+	float level;           // latest quantile estimate
+	float gain;
+} Agc;
+
+
+/* Function declarations. */
+bool agc_init(Agc *a, int window, float quantile, float target, float min_gain, float max_gain, float smoothing);
+float agc_update(Agc *a, const float *levels, int n);
+void agc_free(Agc *a);
+
+#endif
@@ -0,0 +1,133 @@
+/** AUDIOFILE
+ *
+ * WAV and raw PCM reader.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "audiofile.h"
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_EXTENSIBLE 0xfffe
+
+
+static uint32_t le32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+
+static uint16_t le16(const uint8_t *p) {
+	return p[0] | p[1] << 8;
+}
+
+
+/** Walk the RIFF chunks up to "data", checking the "fmt " chunk on the
+ * way. Leaves the file at the first sample. */
+static bool read_wav_header(AudioFile *af, const char *path) {
+	uint8_t riff[12], chunk[8], fmt[16];
+	bool have_fmt = false;
+
+	if (fread(riff, 1, 12, af->f) != 12 || memcmp(riff + 8, "WAVE", 4) != 0) {
+		fprintf(stderr, "audiofile: %s is not a WAVE file.\n", path);
+		return false;
+	}
+
+	while (fread(chunk, 1, 8, af->f) == 8) {
+		uint32_t size = le32(chunk + 4);
+
+		if (memcmp(chunk, "fmt ", 4) == 0) {
+			if (size < 16 || fread(fmt, 1, 16, af->f) != 16)
+				break;
+			uint16_t format = le16(fmt);
+			af->channels = le16(fmt + 2);
+			af->rate = le32(fmt + 4);
+			if ((format != WAVE_FORMAT_PCM && format != WAVE_FORMAT_EXTENSIBLE) ||
+					le16(fmt + 14) != 16 || af->channels < 1) {
+				fprintf(stderr, "audiofile: %s is not 16-bit PCM.\n", path);
+				return false;
+			}
+			have_fmt = true;
+			size -= 16;
+		} else if (memcmp(chunk, "data", 4) == 0) {
+			if (!have_fmt)
+				break;
+			af->frames_left = size / (2 * af->channels);
+			return true;
+		}
+
+		/* Chunks are padded to an even length. */
+		if (fseek(af->f, size + (size & 1), SEEK_CUR) != 0)
+			break;
+	}
+
+	fprintf(stderr, "audiofile: %s has no audio data.\n", path);
+	return false;
+}
+
+
+/** Open `path` for reading. Raw files are assumed to be sampled at
+ * `raw_rate`. */
+bool audio_file_open(AudioFile *af, const char *path, int raw_rate) {
+	char magic[4];
+
+	memset(af, 0, sizeof(AudioFile));
+	if ((af->f = fopen(path, "rb")) == NULL) {
+		perror(path);
+		return false;
+	}
+
+	af->wav = fread(magic, 1, 4, af->f) == 4 && memcmp(magic, "RIFF", 4) == 0;
+	rewind(af->f);
+	if (af->wav) {
+		if (!read_wav_header(af, path)) {
+			audio_file_close(af);
+			return false;
+		}
+	} else {
+		af->rate = raw_rate;
+		af->channels = 1;
+	}
+	return true;
+}
+
+
+/** Read up to `frames` mono samples into `buf`. Returns the number read,
+ * 0 at the end of the audio. */
+int audio_file_read(AudioFile *af, short *buf, int frames) {
+	if (af->wav && (uint64_t) frames > af->frames_left)
+		frames = af->frames_left;
+	if (af->channels == 1) {
+		int n = fread(buf, sizeof(short), frames, af->f);
+		af->frames_left -= af->wav ? n : 0;
+		return n;
+	}
+
+	if (af->frame_buf_size < frames) {
+		short *fb = realloc(af->frame_buf, (size_t) frames * af->channels * sizeof(short));
+		if (fb == NULL) {
+			fprintf(stderr, "audiofile: error allocating read buffer.\n");
+			return 0;
+		}
+		af->frame_buf = fb;
+		af->frame_buf_size = frames;
+	}
+
+	int n = fread(af->frame_buf, sizeof(short) * af->channels, frames, af->f);
+	for (int i = 0; i < n; ++i) {
+		int sum = 0;
+		for (int c = 0; c < af->channels; ++c)
+			sum += af->frame_buf[i * af->channels + c];
+		buf[i] = sum / af->channels;
+	}
+	af->frames_left -= n;
+	return n;
+}
+
+
+void audio_file_close(AudioFile *af) {
+	if (af->f != NULL)
+		fclose(af->f);
+	free(af->frame_buf);
+	af->f = NULL;
+	af->frame_buf = NULL;
+}
@@ -0,0 +1,36 @@
+/** AUDIOFILE
+ *
+ * Read recorded audio for offline rendering. WAV files with 16-bit PCM
+ * samples are read from their header, and any number of channels is
+ * mixed down to mono. Any other file is taken as raw native-endian int16
+ * mono PCM at the rate the caller gives, which is what `generator -b`
+ * writes. Samples are read in host byte order, so WAV files need a
+ * little-endian host, as on the Pi and x86.
+ */
+
+#ifndef AUDIOFILE_H
+#define AUDIOFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/* Data structures. */
+typedef struct {
+	FILE *f;
+	int rate;              // Hz
+	int channels;
+	uint64_t frames_left;  // WAV: frames left in the data chunk
+	bool wav;
+	short *frame_buf;      // interleaved samples of one read
+	int frame_buf_size;    // frames
+} AudioFile;
+
+
+/* Function declarations. */
+bool audio_file_open(AudioFile *af, const char *path, int raw_rate);
+int audio_file_read(AudioFile *af, short *buf, int frames);
+void audio_file_close(AudioFile *af);
+
+#endif
@@ -0,0 +1,188 @@
+/** AUTOTUNE
+ *
+ * Candidate timing and the block size cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "autotune.h"
+#include "fftr_plans.h"
+#include "kiss_fftr.h"
+#include "pipeline.h"
+
+
+/** Read a one-line description of the CPU into `model`, for keying the
+ * cache. x86 names the model; the Pi kernels only name the board. */
+static void cpu_model(char *model, size_t size) {
+	static const char *keys[] = {"model name", "Model", "Hardware"};
+	char line[256];
+	FILE *f;
+
+	snprintf(model, size, "unknown");
+	if ((f = fopen("/proc/cpuinfo", "r")) == NULL)
+		return;
+	for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); ++k) {
+		rewind(f);
+		while (fgets(line, sizeof(line), f) != NULL) {
+			char *colon = strchr(line, ':');
+			if (colon == NULL || strncmp(line, keys[k], strlen(keys[k])) != 0)
+				continue;
+			char *value = colon + 1 + strspn(colon + 1, " \t");
+			value[strcspn(value, "\n")] = '\0';
+			snprintf(model, size, "%s", value);
+			fclose(f);
+			return;
+		}
+	}
+	fclose(f);
+}
+
+
+/** Look up the cached block size for this configuration, or 0. */
+static int cache_lookup(const char *cache, int requested, int decimation, int rate, const char *model) {
+	char line[512];
+	int size = 0;
+	FILE *f;
+
+	if ((f = fopen(cache, "r")) == NULL)
+		return 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		int s, r, d, fs, n;
+		if (sscanf(line, "%d %d %d %d %n", &s, &r, &d, &fs, &n) != 4)
+			continue;
+		line[strcspn(line, "\n")] = '\0';
+		if (r == requested && d == decimation && fs == rate &&
+				strcmp(line + n, model) == 0 && s > 0)
+			size = s;
+	}
+	fclose(f);
+	return size;
+}
+
+
+/** Store `size` for this configuration, keeping the entries for other
+ * configurations. The file is replaced atomically. */
+static void cache_store(const char *cache, int size, int requested, int decimation, int rate, const char *model) {
+	char tmp[512], line[512];
+	FILE *in, *out;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", cache);
+	if ((out = fopen(tmp, "w")) == NULL) {
+		perror("autotune: cache");
+		return;
+	}
+	if ((in = fopen(cache, "r")) != NULL) {
+		while (fgets(line, sizeof(line), in) != NULL) {
+			int s, r, d, fs, n;
+			char key[512];
+			if (sscanf(line, "%d %d %d %d %n", &s, &r, &d, &fs, &n) != 4)
+				continue;
+			snprintf(key, sizeof(key), "%s", line + n);
+			key[strcspn(key, "\n")] = '\0';
+			if (r != requested || d != decimation || fs != rate || strcmp(key, model) != 0)
+				fputs(line, out);
+		}
+		fclose(in);
+	}
+	fprintf(out, "%d %d %d %d %s\n", size, requested, decimation, rate, model);
+	if (fclose(out) != 0 || rename(tmp, cache) != 0) {
+		perror("autotune: cache");
+		remove(tmp);
+	}
+}
+
+
+/** CPU time per second of audio, in ns, for one FFT of `nfft` points on
+ * every `block` samples at `rate` Hz. Returns a negative value if the
+ * plan cannot be allocated. */
+static double time_candidate(int nfft, int block, int rate) {
+	kiss_fftr_cfg cfg = fftr_plan_alloc(nfft);
+	kiss_fft_scalar *in = malloc(nfft * sizeof(kiss_fft_scalar));
+	kiss_fft_cpx *out = malloc((nfft / 2 + 1) * sizeof(kiss_fft_cpx));
+	double best = -1;
+
+	if (cfg == NULL || in == NULL || out == NULL)
+		goto done;
+
+	/* Any non-trivial input will do; the kernels have no data-dependent
+	 * branches. */
+	for (int i = 0; i < nfft; ++i)
+		in[i] = (i * 7919 % 2003) - 1001;
+	kiss_fftr(cfg, in, out);
+
+	for (int round = 0; round < AUTOTUNE_ROUNDS; ++round) {
+		uint64_t start = monotonic_ns(), elapsed;
+		long runs = 0;
+		do {
+			kiss_fftr(cfg, in, out);
+			runs++;
+			elapsed = monotonic_ns() - start;
+		} while (elapsed < AUTOTUNE_MIN_NS);
+
+		double per_second = (double) elapsed / runs * rate / block;
+		if (best < 0 || per_second < best)
+			best = per_second;
+	}
+
+done:
+	free(cfg);
+	free(in);
+	free(out);
+	return best;
+}
+
+
+/** Time the FFT of `nfft` points and keep it in `*best_size` if it beats
+ * `*best_ns`. */
+static void consider(int nfft, int decimation, int rate, int *best_size, double *best_ns) {
+	int block = nfft * decimation;
+	double ns = time_candidate(nfft, block, rate);
+
+	if (ns < 0)
+		return;
+	fprintf(stderr, "  %5d samples: %7.3f ms CPU per s of audio%s\n",
+			block, ns / 1e6, fftr_plan_is_prebuilt(nfft) ? " (prebuilt)" : "");
+	if (*best_ns < 0 || ns < *best_ns) {
+		*best_ns = ns;
+		*best_size = block;
+	}
+}
+
+
+/** Return the block size within `range` (a fraction) of `requested` whose
+ * FFT costs the least CPU per second of audio. The FFT runs on
+ * block / `decimation` points at `rate` / `decimation` Hz.
+ *
+ * A cached result for this CPU and configuration is used unless `force`
+ * is set or `cache` is empty. */
+int autotune_block_size(int requested, int rate, int decimation, float range, const char *cache, bool force) {
+	char model[256];
+	int best_size = requested;
+	double best_ns = -1;
+
+	cpu_model(model, sizeof(model));
+
+	if (!force && cache[0] != '\0') {
+		int size = cache_lookup(cache, requested, decimation, rate, model);
+		if (size > 0)
+			return size;
+	}
+
+	/* The requested size first, then every fast size in range. */
+	int base = requested / decimation;
+	int lo = base * (1 - range);
+	int hi = base * (1 + range);
+
+	fprintf(stderr, "Autotuning block size near %d on %s:\n", requested, model);
+	consider(base, decimation, rate, &best_size, &best_ns);
+	for (int nfft = kiss_fftr_next_fast_size_real(lo); nfft <= hi;
+			nfft = kiss_fftr_next_fast_size_real(nfft + 1))
+		if (nfft != base)
+			consider(nfft, decimation, rate, &best_size, &best_ns);
+	fprintf(stderr, "Using %d samples per block.\n", best_size);
+
+	if (cache[0] != '\0')
+		cache_store(cache, best_size, requested, decimation, rate, model);
+	return best_size;
+}
@@ -0,0 +1,28 @@
+/** AUTOTUNE
+ *
+ * Pick the audio block size near a requested one whose real FFT is
+ * cheapest on this CPU. Candidates are the sizes within a fraction of the
+ * request that `kiss_fftr_next_fast_size_real` accepts (FFT sizes whose
+ * half has only the factors 2, 3 and 5), plus the request itself. Each
+ * is timed with the plan `fftr_plan_alloc` would use, prebuilt or not,
+ * and ranked by CPU time per second of audio.
+ *
+ * The choice is kept in a small text cache, one line per CPU model and
+ * configuration, so later starts on the same board skip the measurement:
+ *
+ *     <block size> <requested> <decimation> <rate> <cpu model>
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdbool.h>
+
+#define AUTOTUNE_MIN_NS 20000000   // time every candidate for at least 20 ms
+#define AUTOTUNE_ROUNDS 3          // best of this many timing rounds
+
+
+/* Function declarations. */
+int autotune_block_size(int requested, int rate, int decimation, float range, const char *cache, bool force);
+
+#endif
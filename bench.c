@@ -0,0 +1,346 @@
+/** Bench.
+ *
+ * Micro-benchmarks for the analysis front-end, run on deterministic pink
+ * noise from signals.c:
+ *
+ *     bench [-n block] [-r rate] [-b blocks]
+ *
+ * `decimate` compares the plain `N`-point real FFT against the polyphase
+ * decimator followed by an `N / factor`-point FFT, reporting the time per
+ * block and the CPU time spent per second of audio.
+ *
+ * `pruned` times `kiss_fftr_pruned` on the bins each display mode reads
+ * on a `BENCH_COLS`x`BENCH_ROWS` panel, against the full real FFT.
+ *
+ * `pair` transforms consecutive blocks two at a time with
+ * `kiss_fft_real_pair`, checks the spectra against `kiss_fftr` on each
+ * block and compares the time per block.
+ *
+ * Every measurement follows an untimed warm-up pass and is the least
+ * process CPU time of `BENCH_REPEATS` runs, so cold caches, page faults
+ * and preemption do not show in it.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "decimate.h"
+#include "kiss_fftr.h"
+#include "signals.h"
+
+#define BENCH_BLOCK 1600     // default samples per block, as N in vmatrix.h
+#define BENCH_RATE 44100     // default sampling rate, as FS in vmatrix.h
+#define BENCH_BLOCKS 20000   // default blocks per measurement
+#define BENCH_TAPS 12        // decimator taps per phase, as DECIMATION_TAPS
+#define BENCH_COLS 64        // panel size, as MATRIX_COLS and MATRIX_ROWS
+#define BENCH_ROWS 32
+#define BENCH_REPEATS 5      // timed runs per measurement, the fastest is reported
+
+
+/* Results are accumulated here so the compiler cannot drop the work being
+ * timed. */
+volatile float bench_sink;
+
+
+/** One timed loop: processes `blocks` blocks with the state in `ctx`. */
+typedef void (*BenchLoop)(void *ctx, int blocks);
+
+
+static double cpu_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/** CPU seconds `loop` takes for `blocks` blocks: the fastest of
+ * BENCH_REPEATS runs after one untimed warm-up run. */
+static double time_loop(BenchLoop loop, void *ctx, int blocks) {
+	double best = INFINITY;
+
+	loop(ctx, blocks);
+	for (int r = 0; r < BENCH_REPEATS; ++r) {
+		double start = cpu_seconds();
+		loop(ctx, blocks);
+		double seconds = cpu_seconds() - start;
+		if (seconds < best)
+			best = seconds;
+	}
+	return best;
+}
+
+
+/** Print one result line. */
+static void report(const char *name, double seconds, int blocks, int block, int rate) {
+	double per_block = seconds / blocks;
+	double blocks_per_second = (double) rate / block;
+	printf("%-22s %9.2f us/block %8.2f ms CPU per s of audio\n", name,
+			per_block * 1e6, per_block * blocks_per_second * 1e3);
+}
+
+
+typedef struct {
+	const short *audio;
+	int block;
+	int factor;
+	int kmax;                // bench_pruned: last bin computed, 0 for all
+	Decimator dec;
+	kiss_fftr_cfg cfg;
+	kiss_fft_scalar *in;
+	kiss_fft_cpx *out;
+} FftBench;
+
+
+static void decimate_loop(void *ctx, int blocks) {
+	FftBench *f = ctx;
+
+	for (int b = 0; b < blocks; ++b) {
+		const short *buf = f->audio + (size_t) (b % 64) * f->block;
+		if (f->factor > 1)
+			decimator_process(&f->dec, buf, f->in);
+		else
+			for (int i = 0; i < f->block; ++i)
+				f->in[i] = buf[i];
+		kiss_fftr(f->cfg, f->in, f->out);
+		bench_sink += f->out[1].r;
+	}
+}
+
+
+/** Time the FFT of `block` samples with and without decimation. */
+static void bench_decimate(const short *audio, int blocks, int block, int rate) {
+	static const int factors[] = {1, 2, 4, 5};
+	FftBench f = {.audio = audio, .block = block};
+
+	f.in = malloc(block * sizeof(kiss_fft_scalar));
+	f.out = malloc((block / 2 + 1) * sizeof(kiss_fft_cpx));
+	for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); ++i) {
+		int factor = factors[i];
+		int nfft = block / factor;
+		char name[64];
+
+		if (block % factor != 0 || nfft % 2 != 0)
+			continue;
+		f.factor = factor;
+		if ((f.cfg = kiss_fftr_alloc(nfft, 0, NULL, NULL)) == NULL ||
+				(factor > 1 && !decimator_init(&f.dec, factor, BENCH_TAPS, block))) {
+			fprintf(stderr, "bench: allocation failed.\n");
+			exit(1);
+		}
+
+		double seconds = time_loop(decimate_loop, &f, blocks);
+
+		if (factor > 1)
+			snprintf(name, sizeof(name), "decimate %d + fft %d", factor, nfft);
+		else
+			snprintf(name, sizeof(name), "fft %d", nfft);
+		report(name, seconds, blocks, block, rate);
+
+		if (factor > 1)
+			decimator_free(&f.dec);
+		free(f.cfg);
+	}
+
+	free(f.in);
+	free(f.out);
+}
+
+
+static void pruned_loop(void *ctx, int blocks) {
+	FftBench *f = ctx;
+
+	for (int b = 0; b < blocks; ++b) {
+		const short *buf = f->audio + (size_t) (b % 64) * f->block;
+		for (int i = 0; i < f->block; ++i)
+			f->in[i] = buf[i];
+		if (f->kmax > 0)
+			kiss_fftr_pruned(f->cfg, f->in, f->out, 0, f->kmax);
+		else
+			kiss_fftr(f->cfg, f->in, f->out);
+		bench_sink += f->out[1].r;
+	}
+}
+
+
+/** Time the pruned real FFT of `block` samples for the bins each display
+ * mode needs (see `layout_init`), and the full FFT for comparison. */
+static void bench_pruned(const short *audio, int blocks, int block, int rate) {
+	static const struct {
+		const char *name;
+		int kmax;
+	} plans[] = {
+		{"fft", 0},
+		{"pruned histogram", BENCH_COLS},                 // one bin per column
+		{"pruned spectrogram", (BENCH_ROWS + 1) * 2 - 1}, // two bins per row
+	};
+	FftBench f = {.audio = audio, .block = block};
+
+	f.in = malloc(block * sizeof(kiss_fft_scalar));
+	f.out = malloc((block / 2 + 1) * sizeof(kiss_fft_cpx));
+	f.cfg = kiss_fftr_alloc(block, 0, NULL, NULL);
+	if (f.in == NULL || f.out == NULL || f.cfg == NULL) {
+		fprintf(stderr, "bench: allocation failed.\n");
+		exit(1);
+	}
+
+	for (size_t p = 0; p < sizeof(plans) / sizeof(plans[0]); ++p) {
+		int kmax = f.kmax = plans[p].kmax;
+		char name[64];
+
+		double seconds = time_loop(pruned_loop, &f, blocks);
+
+		if (kmax > 0)
+			snprintf(name, sizeof(name), "%s 0-%d", plans[p].name, kmax);
+		else
+			snprintf(name, sizeof(name), "%s %d", plans[p].name, block);
+		report(name, seconds, blocks, block, rate);
+	}
+
+	free(f.cfg);
+	free(f.in);
+	free(f.out);
+}
+
+
+typedef struct {
+	const short *audio;
+	int block;
+	bool pair;               // kiss_fft_real_pair rather than two kiss_fftr
+	kiss_fft_scalar *a, *b;
+	kiss_fft_cpx *out_a, *out_b, *scratch;
+	kiss_fftr_cfg real_cfg;
+	kiss_fft_cfg pair_cfg;
+} PairBench;
+
+
+static void pair_loop(void *ctx, int blocks) {
+	PairBench *w = ctx;
+	int block = w->block;
+
+	for (int p = 0; p < blocks / 2; ++p) {
+		const short *buf = w->audio + (size_t) (2 * p % 64) * block;
+		for (int i = 0; i < block; ++i) {
+			w->a[i] = buf[i];
+			w->b[i] = buf[block + i];
+		}
+		if (!w->pair) {
+			kiss_fftr(w->real_cfg, w->a, w->out_a);
+			kiss_fftr(w->real_cfg, w->b, w->out_b);
+		} else {
+			kiss_fft_real_pair(w->pair_cfg, w->a, w->b, w->out_a, w->out_b, w->scratch);
+		}
+		bench_sink += w->out_a[1].r + w->out_b[1].r;
+	}
+}
+
+
+/** Time and check the two-frames-per-transform path against `kiss_fftr`
+ * one block at a time. */
+static void bench_pair(const short *audio, int blocks, int block, int rate) {
+	int bins = block / 2 + 1;
+	kiss_fft_scalar *a = malloc(block * sizeof(kiss_fft_scalar));
+	kiss_fft_scalar *b = malloc(block * sizeof(kiss_fft_scalar));
+	kiss_fft_cpx *out_a = malloc(bins * sizeof(kiss_fft_cpx));
+	kiss_fft_cpx *out_b = malloc(bins * sizeof(kiss_fft_cpx));
+	kiss_fft_cpx *ref = malloc(bins * sizeof(kiss_fft_cpx));
+	kiss_fft_cpx *scratch = malloc(2 * block * sizeof(kiss_fft_cpx));
+	kiss_fftr_cfg real_cfg = kiss_fftr_alloc(block, 0, NULL, NULL);
+	kiss_fft_cfg pair_cfg = kiss_fft_alloc(block, 0, NULL, NULL);
+
+	if (a == NULL || b == NULL || out_a == NULL || out_b == NULL || ref == NULL ||
+			scratch == NULL || real_cfg == NULL || pair_cfg == NULL) {
+		fprintf(stderr, "bench: allocation failed.\n");
+		exit(1);
+	}
+
+	/* Check every pair of the 64 blocks against the one-block path, as
+	 * the largest error relative to the largest magnitude. */
+	double max_err = 0, max_mag = 0;
+	for (int p = 0; p < 32; ++p) {
+		for (int i = 0; i < block; ++i) {
+			a[i] = audio[(size_t) 2 * p * block + i];
+			b[i] = audio[(size_t) (2 * p + 1) * block + i];
+		}
+		kiss_fft_real_pair(pair_cfg, a, b, out_a, out_b, scratch);
+		for (int f = 0; f < 2; ++f) {
+			kiss_fft_cpx *out = f == 0 ? out_a : out_b;
+			kiss_fftr(real_cfg, f == 0 ? a : b, ref);
+			for (int k = 0; k < bins; ++k) {
+				double err = hypot(out[k].r - ref[k].r, out[k].i - ref[k].i);
+				double mag = hypot(ref[k].r, ref[k].i);
+				if (err > max_err) max_err = err;
+				if (mag > max_mag) max_mag = mag;
+			}
+		}
+	}
+
+	PairBench w = {
+		.audio = audio, .block = block, .a = a, .b = b, .out_a = out_a,
+		.out_b = out_b, .scratch = scratch, .real_cfg = real_cfg, .pair_cfg = pair_cfg,
+	};
+	for (int path = 0; path < 2; ++path) {
+		w.pair = path == 1;
+		double seconds = time_loop(pair_loop, &w, blocks);
+		report(path == 0 ? "fftr, one block" : "fft pair, two blocks", seconds,
+				blocks / 2 * 2, block, rate);
+	}
+	printf("fft pair max relative error %.1e\n", max_mag > 0 ? max_err / max_mag : 0);
+
+	free(real_cfg);
+	free(pair_cfg);
+	free(a);
+	free(b);
+	free(out_a);
+	free(out_b);
+	free(ref);
+	free(scratch);
+}
+
+
+int main(int argc, char *argv[]) {
+	int block = BENCH_BLOCK;
+	int rate = BENCH_RATE;
+	int blocks = BENCH_BLOCKS;
+	Signal signal;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:b:")) != -1) {
+		switch (opt) {
+			case 'n': block = atoi(optarg); break;
+			case 'r': rate = atoi(optarg); break;
+			case 'b': blocks = atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-n block] [-r rate] [-b blocks]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (block <= 0 || block % 2 != 0 || rate <= 0 || blocks <= 0) {
+		fprintf(stderr, "bench: block must be even and all values positive.\n");
+		return 1;
+	}
+
+	/* 64 blocks of pink noise, cycled through by every benchmark. */
+	float *samples = malloc((size_t) 64 * block * sizeof(float));
+	short *audio = malloc((size_t) 64 * block * sizeof(short));
+	if (samples == NULL || audio == NULL) {
+		fprintf(stderr, "bench: allocation failed.\n");
+		return 1;
+	}
+	sine_table_init();
+	signal_init(&signal, SIGNAL_PINK, rate, SIGNAL_DEFAULT_SEED);
+	signal_fill(&signal, samples, 64 * block);
+	for (int i = 0; i < 64 * block; ++i)
+		audio[i] = samples[i] * 16000;
+
+	printf("block %d samples at %d Hz, %d blocks\n", block, rate, blocks);
+	bench_decimate(audio, blocks, block, rate);
+	bench_pruned(audio, blocks, block, rate);
+	bench_pair(audio, blocks, block, rate);
+
+	free(samples);
+	free(audio);
+	return 0;
+}
@@ -0,0 +1,144 @@
+/** COLUMNS
+ *
+ * SIMD kernels over the per-column histogram state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "columns.h"
+
+
+typedef float v4sf __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+
+
+/** Lane-wise `mask ? a : b`, where `mask` lanes are all ones or all zeros. */
+static inline v4sf select4(v4si mask, v4sf a, v4sf b) {
+	return (v4sf) (((v4si) a & mask) | ((v4si) b & ~mask));
+}
+
+
+static inline v4sf min4(v4sf a, v4sf b) {
+	return select4(a < b, a, b);
+}
+
+
+/** Truncate toward zero, as the `(int)` casts of the scalar code did. */
+static inline v4sf trunc4(v4sf a) {
+	return __builtin_convertvector(__builtin_convertvector(a, v4si), v4sf);
+}
+
+
+/** Allocate zeroed state for `width` columns. */
+ColumnState *column_state_alloc(int width) {
+	ColumnState *cs;
+	float *mem;
+
+	if ((cs = calloc(1, sizeof(ColumnState))) == NULL)
+		return NULL;
+
+	cs->width = width;
+	cs->stride = (width + COLUMN_LANES - 1) / COLUMN_LANES * COLUMN_LANES;
+
+	size_t bytes = COLUMN_ARRAYS * cs->stride * sizeof(float);
+	if (posix_memalign((void **) &mem, COLUMN_ALIGN, bytes) != 0) {
+		free(cs);
+		return NULL;
+	}
+	memset(mem, 0, bytes);
+
+	cs->level = mem;
+	cs->target = mem + cs->stride;
+	cs->envelope = mem + 2 * cs->stride;
+	cs->counter = mem + 3 * cs->stride;
+	cs->prev = mem + 4 * cs->stride;
+	cs->shown = mem + 5 * cs->stride;
+	return cs;
+}
+
+
+void column_state_free(ColumnState *cs) {
+	if (cs == NULL)
+		return;
+	free(cs->level);
+	free(cs);
+}
+
+
+/** Convert binned amplitudes to bar rows and blend them into `level`,
+ * keeping the old value in `prev`:
+ *
+ *     target = height - min(binarr * scaling, height)
+ *     level  = trunc(level * old_weight + target * new_weight) + offset
+ *
+ * `binarr` holds `width` values; lanes past the last column read zero.
+ */
+void column_smooth(ColumnState *cs, const float *binarr, float scaling, int height, float old_weight, float new_weight, float offset) {
+	const v4sf h = {height, height, height, height};
+	const v4sf s = {scaling, scaling, scaling, scaling};
+	const v4sf ow = {old_weight, old_weight, old_weight, old_weight};
+	const v4sf nw = {new_weight, new_weight, new_weight, new_weight};
+	const v4sf off = {offset, offset, offset, offset};
+	int full = cs->width / COLUMN_LANES * COLUMN_LANES;
+
+	for (int x = 0; x < cs->stride; x += COLUMN_LANES) {
+		v4sf b = {0, 0, 0, 0};
+		if (x < full)
+			memcpy(&b, binarr + x, sizeof(b));
+		else
+			memcpy(&b, binarr + x, (cs->width - x) * sizeof(float));
+
+		v4sf target = h - trunc4(min4(b * s, h));
+		v4sf *level = (v4sf *) (cs->level + x);
+
+		*(v4sf *) (cs->prev + x) = *level;
+		*level = trunc4(*level * ow + target * nw) + off;
+		*(v4sf *) (cs->target + x) = target;
+	}
+}
+
+
+/** Let the envelope jump up to each new bar top and fall back one row
+ * every `hold` + 1 frames, clamped to the bottom row:
+ *
+ *     envelope = min(envelope, target, height)
+ *     if (counter-- < 0) { envelope += 1; counter = hold; }
+ */
+void column_envelope(ColumnState *cs, int height, int hold) {
+	const v4sf h = {height, height, height, height};
+	const v4sf one = {1, 1, 1, 1};
+	const v4sf zero = {0, 0, 0, 0};
+	const v4sf reset = {hold, hold, hold, hold};
+
+	for (int x = 0; x < cs->stride; x += COLUMN_LANES) {
+		v4sf *env = (v4sf *) (cs->envelope + x);
+		v4sf *ctr = (v4sf *) (cs->counter + x);
+		v4sf target = *(v4sf *) (cs->target + x);
+
+		v4sf e = min4(min4(*env, target), h);
+		v4si fall = *ctr < zero;
+
+		*env = e + select4(fall, one, zero);
+		*ctr = select4(fall, reset, *ctr - one);
+	}
+}
+
+
+/** Place the bars `t` of the way from `prev` to `level` (t > 1
+ * extrapolates), never above the top row:
+ *
+ *     shown = max(prev + (level - prev) * t, 0)
+ */
+void column_interpolate(ColumnState *cs, float t) {
+	const v4sf tt = {t, t, t, t};
+	const v4sf zero = {0, 0, 0, 0};
+
+	for (int x = 0; x < cs->stride; x += COLUMN_LANES) {
+		v4sf prev = *(v4sf *) (cs->prev + x);
+		v4sf level = *(v4sf *) (cs->level + x);
+		v4sf shown = prev + (level - prev) * tt;
+
+		*(v4sf *) (cs->shown + x) = select4(shown < zero, zero, shown);
+	}
+}
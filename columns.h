@@ -0,0 +1,40 @@
+/** COLUMNS
+ *
+ * Per-column histogram state stored as a structure of arrays, with the
+ * attack/decay smoothing and the envelope fall-off written as branch-free
+ * SIMD kernels (GCC vector extensions, which lower to NEON on the Pi and
+ * SSE on x86).
+ *
+ * Every array holds `stride` floats, `width` rounded up to COLUMN_LANES, and
+ * is aligned to COLUMN_ALIGN bytes so the kernels never need a scalar tail.
+ */
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#define COLUMN_LANES 4   // floats per SIMD vector
+#define COLUMN_ALIGN 16  // bytes
+#define COLUMN_ARRAYS 6  // arrays of `stride` floats in one allocation
+
+
+/* Data structures. */
+typedef struct {
+	int width;        // visible columns
+	int stride;       // allocated columns, multiple of COLUMN_LANES
+	float *level;     // smoothed top row of each bar
+	float *prev;      // `level` before the latest frame
+	float *shown;     // `level` interpolated to the time being drawn
+	float *target;    // unsmoothed top row from the latest frame
+	float *envelope;  // row of the amplitude envelope
+	float *counter;   // frames until the envelope falls one row
+} ColumnState;
+
+
+/* Function declarations. */
+ColumnState *column_state_alloc(int width);
+void column_state_free(ColumnState *cs);
+void column_smooth(ColumnState *cs, const float *binarr, float scaling, int height, float old_weight, float new_weight, float offset);
+void column_envelope(ColumnState *cs, int height, int hold);
+void column_interpolate(ColumnState *cs, float t);
+
+#endif
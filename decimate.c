@@ -0,0 +1,94 @@
+/** DECIMATE
+ *
+ * Windowed-sinc design and the SIMD filter loop for the decimator.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decimate.h"
+
+
+typedef float v4sf __attribute__((vector_size(16)));
+
+
+/** Design the filter and allocate the delay line. `block_size` must be a
+ * multiple of `factor`. */
+bool decimator_init(Decimator *d, int factor, int taps_per_phase, int block_size) {
+	memset(d, 0, sizeof(Decimator));
+	if (factor < 1 || taps_per_phase < 1 || block_size % factor != 0)
+		return false;
+
+	d->factor = factor;
+	d->block_size = block_size;
+	d->taps = (factor * taps_per_phase + DECIMATE_LANES - 1) /
+		DECIMATE_LANES * DECIMATE_LANES;
+
+	if (posix_memalign((void **) &d->coeffs, DECIMATE_ALIGN,
+				d->taps * sizeof(float)) != 0) {
+		d->coeffs = NULL;
+		return false;
+	}
+	if ((d->buf = calloc(d->taps - 1 + block_size, sizeof(float))) == NULL) {
+		decimator_free(d);
+		return false;
+	}
+
+	/* Blackman-windowed sinc over the first `factor * taps_per_phase`
+	 * taps, cut off at the decimated Nyquist frequency and normalized to
+	 * unity gain at DC. Padding taps stay zero. */
+	int len = factor * taps_per_phase;
+	double fc = 0.5 / factor;
+	double sum = 0;
+	double h[len];
+	for (int k = 0; k < len; ++k) {
+		double m = k - (len - 1) / 2.0;
+		double sinc = m == 0 ? 2 * fc : sin(2 * M_PI * fc * m) / (M_PI * m);
+		double w = 0.42 - 0.5 * cos(2 * M_PI * k / (len - 1))
+			+ 0.08 * cos(4 * M_PI * k / (len - 1));
+		h[k] = len > 1 ? sinc * w : 1;
+		sum += h[k];
+	}
+	memset(d->coeffs, 0, d->taps * sizeof(float));
+	for (int k = 0; k < len; ++k)
+		d->coeffs[d->taps - 1 - k] = h[k] / sum;
+
+	return true;
+}
+
+
+void decimator_free(Decimator *d) {
+	free(d->coeffs);
+	free(d->buf);
+	d->coeffs = NULL;
+	d->buf = NULL;
+}
+
+
+/** Filter one block of `block_size` samples from `in` and write
+ * `block_size / factor` decimated samples to `out`. */
+void decimator_process(Decimator *d, const short *in, kiss_fft_scalar *out) {
+	int hist = d->taps - 1;
+	float *x = d->buf + hist;
+
+	for (int i = 0; i < d->block_size; ++i)
+		x[i] = in[i];
+
+	/* Output m is the dot product of the reversed taps with the window of
+	 * inputs ending at sample m * factor; the skipped outputs are never
+	 * computed. */
+	for (int m = 0; m < d->block_size / d->factor; ++m) {
+		const float *win = d->buf + m * d->factor;
+		v4sf acc = {0, 0, 0, 0};
+
+		for (int k = 0; k < d->taps; k += DECIMATE_LANES) {
+			v4sf a, c = *(const v4sf *) (d->coeffs + k);
+			memcpy(&a, win + k, sizeof(a));
+			acc += a * c;
+		}
+		out[m] = acc[0] + acc[1] + acc[2] + acc[3];
+	}
+
+	/* Keep the tail of this block as history for the next one. */
+	memmove(d->buf, d->buf + d->block_size, hist * sizeof(float));
+}
@@ -0,0 +1,40 @@
+/** DECIMATE
+ *
+ * Polyphase FIR decimator between capture and the FFT. Only every
+ * `factor`-th output of the anti-aliasing filter is computed, so the
+ * filter costs `taps / factor` multiply-adds per input sample, and the FFT
+ * after it runs at `factor` times fewer points for the same frequency
+ * resolution.
+ *
+ * The filter is a short Blackman-windowed sinc cut off at the decimated
+ * Nyquist frequency. Its wide transition band lets some content near the
+ * old Nyquist fold back, but only into the top of the decimated band, far
+ * above the columns that are displayed.
+ */
+
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdbool.h>
+#include "kiss_fft.h"
+
+#define DECIMATE_LANES 4   // floats per SIMD vector
+#define DECIMATE_ALIGN 16  // bytes
+
+
+/* Data structures. */
+typedef struct {
+	int factor;
+	int taps;          // filter length, a multiple of DECIMATE_LANES
+	int block_size;    // input samples per call
+	float *coeffs;     // `taps` coefficients, time-reversed
+	float *buf;        // `taps` - 1 samples of history, then one block
+} Decimator;
+
+
+/* Function declarations. */
+bool decimator_init(Decimator *d, int factor, int taps_per_phase, int block_size);
+void decimator_free(Decimator *d);
+void decimator_process(Decimator *d, const short *in, kiss_fft_scalar *out);
+
+#endif
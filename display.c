@@ -0,0 +1,39 @@
+/** DISPLAY
+ *
+ * Framebuffer shared by all display sinks.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "display.h"
+
+
+/** Allocate a display with a cleared framebuffer. The caller fills in
+ * `present`, `destroy` and `state`. */
+Display *display_alloc(int width, int height) {
+	Display *d;
+
+	if ((d = calloc(1, sizeof(Display))) == NULL)
+		return NULL;
+	d->width = width;
+	d->height = height;
+	if ((d->pixels = calloc((size_t) width * height, 3)) == NULL) {
+		free(d);
+		return NULL;
+	}
+	return d;
+}
+
+
+/** Free the framebuffer and the display itself. */
+void display_free(Display *d) {
+	if (d == NULL)
+		return;
+	free(d->pixels);
+	free(d);
+}
+
+
+void display_clear(Display *d) {
+	memset(d->pixels, 0, (size_t) d->width * d->height * 3);
+}
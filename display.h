@@ -0,0 +1,114 @@
+/** DISPLAY
+ *
+ * Display sinks. Renderers draw into an RGB framebuffer owned by a
+ * `Display`; `display_present` hands the finished frame to the sink, which
+ * may be the local LED matrix (display_led.h) or a remote panel driver
+ * reached over UDP or a Unix socket.
+ *
+ * Remote frames are sent as a keyframe (raw RGB) or as an XOR delta
+ * against the previous frame, run-length coded so that unchanged pixels
+ * cost nothing. Deltas name the frame they apply to; after a lost
+ * datagram the receiver waits for the next keyframe.
+ *
+ * For offline rendering, frames can instead be written to a video file
+ * (display_file.c).
+ */
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REMOTE_MAGIC 0x564d4652     // "VMFR"
+#define REMOTE_VERSION 2
+#define REMOTE_HEADER_SIZE 32       // bytes of header on the wire
+#define REMOTE_KEY_INTERVAL 30      // frames between forced keyframes
+#define REMOTE_MAX_DATAGRAM 65000   // bytes, header included
+#define REMOTE_STATS_INTERVAL 10    // seconds between statistics reports
+
+
+/* Remote frame encodings. */
+enum {
+	REMOTE_KEY,    // raw RGB frame
+	REMOTE_DELTA   // RLE-coded XOR against frame `base_seq`
+};
+
+
+/* Data structures. */
+typedef struct Display Display;
+struct Display {
+	int width;
+	int height;
+	uint8_t *pixels;                 // width * height RGB triplets, row-major
+	void (*present)(Display *d);     // show `pixels`, may wait for vsync
+	void (*destroy)(Display *d);
+	void *state;                     // sink-specific
+};
+
+/* Frame header. On the wire it is REMOTE_HEADER_SIZE bytes, the fields
+ * below in order, little endian and without padding, whatever the layout
+ * of the struct on either machine. */
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t encoding;
+	uint16_t width;
+	uint16_t height;
+	uint32_t seq;            // frame number
+	uint32_t base_seq;       // REMOTE_DELTA: frame the delta applies to
+	uint64_t timestamp_ns;   // CLOCK_REALTIME when sent
+	uint32_t payload_len;
+} RemoteFrameHeader;
+
+typedef struct {
+	uint64_t frames;
+	uint64_t keyframes;
+	uint64_t bytes;
+	uint64_t dropped;        // receiver: deltas without their base frame
+	uint64_t latency_sum_ns; // receiver: send-to-receive latency
+	uint64_t latency_max_ns;
+	uint64_t since_ns;       // start of the current reporting window
+} RemoteStats;
+
+typedef struct RemoteReceiver RemoteReceiver;
+
+
+/* Function declarations. */
+Display *display_alloc(int width, int height);
+void display_free(Display *d);
+void display_clear(Display *d);
+
+Display *remote_display_create(const char *address, int width, int height);
+Display *file_display_create(const char *path, int width, int height, int scale, int fps_num, int fps_den);
+RemoteReceiver *remote_receiver_open(const char *address);
+bool remote_receiver_next(RemoteReceiver *rx, Display *d);
+void remote_receiver_close(RemoteReceiver *rx);
+int remote_encode_delta(const uint8_t *prev, const uint8_t *cur, int len, uint8_t *out, int out_len);
+bool remote_apply_delta(uint8_t *frame, int len, const uint8_t *delta, int delta_len);
+
+
+/** Set one pixel; coordinates outside the display are ignored, like
+ * `led_canvas_set_pixel`. */
+static inline void display_set_pixel(Display *d, int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+	if (x < 0 || y < 0 || x >= d->width || y >= d->height)
+		return;
+	uint8_t *p = d->pixels + 3 * (y * d->width + x);
+	p[0] = r;
+	p[1] = g;
+	p[2] = b;
+}
+
+
+static inline void display_present(Display *d) {
+	d->present(d);
+}
+
+
+static inline void display_destroy(Display *d) {
+	if (d != NULL)
+		d->destroy(d);
+}
+
+#endif
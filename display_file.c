@@ -0,0 +1,101 @@
+/** DISPLAY_FILE
+ *
+ * Write frames to a video file instead of a panel, for offline rendering.
+ *
+ * A path ending in ".y4m" gets a YUV4MPEG2 stream (4:4:4, BT.601 limited
+ * range) that players and encoders read directly. Any other path gets
+ * bare RGB24 frames, e.g. for `ffmpeg -f rawvideo -pix_fmt rgb24`. Each
+ * panel pixel is drawn as a `scale` x `scale` square.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "display.h"
+
+
+typedef struct {
+	FILE *f;
+	bool y4m;
+	int scale;
+	uint8_t *out;            // one scaled frame, RGB or Y, Cb, Cr planes
+	uint64_t frames;
+	bool write_failed;       // an error has already been reported
+} FileState;
+
+
+static void file_present(Display *d) {
+	FileState *s = d->state;
+	int w = d->width * s->scale, h = d->height * s->scale;
+	size_t plane = (size_t) w * h;
+
+	for (int y = 0; y < h; ++y) {
+		const uint8_t *row = d->pixels + 3 * (y / s->scale) * d->width;
+		for (int x = 0; x < w; ++x) {
+			const uint8_t *p = row + 3 * (x / s->scale);
+			size_t i = (size_t) y * w + x;
+			if (s->y4m) {
+				s->out[i] = ((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16;
+				s->out[plane + i] = ((-38 * p[0] - 74 * p[1] + 112 * p[2] + 128) >> 8) + 128;
+				s->out[2 * plane + i] = ((112 * p[0] - 94 * p[1] - 18 * p[2] + 128) >> 8) + 128;
+			} else {
+				memcpy(s->out + 3 * i, p, 3);
+			}
+		}
+	}
+
+	if ((s->y4m && fputs("FRAME\n", s->f) == EOF) ||
+			fwrite(s->out, 1, 3 * plane, s->f) != 3 * plane) {
+		if (!s->write_failed)
+			perror("file display");
+		s->write_failed = true;
+		return;
+	}
+	s->frames++;
+}
+
+
+static void file_destroy(Display *d) {
+	FileState *s = d->state;
+	if (fclose(s->f) != 0 && !s->write_failed)
+		perror("file display");
+	free(s->out);
+	free(s);
+	display_free(d);
+}
+
+
+/** Create a sink that writes `width` x `height` frames to `path`, at
+ * `fps_num` / `fps_den` frames per second. */
+Display *file_display_create(const char *path, int width, int height, int scale, int fps_num, int fps_den) {
+	size_t len = strlen(path);
+	FileState *s;
+	Display *d;
+
+	if ((s = calloc(1, sizeof(FileState))) == NULL)
+		return NULL;
+	s->y4m = len > 4 && strcmp(path + len - 4, ".y4m") == 0;
+	s->scale = scale > 0 ? scale : 1;
+	s->out = malloc((size_t) width * height * s->scale * s->scale * 3);
+	if (s->out == NULL || (s->f = fopen(path, "wb")) == NULL) {
+		if (s->out != NULL)
+			perror(path);
+		free(s->out);
+		free(s);
+		return NULL;
+	}
+	if (s->y4m)
+		fprintf(s->f, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C444\n",
+				width * s->scale, height * s->scale, fps_num, fps_den);
+
+	if ((d = display_alloc(width, height)) == NULL) {
+		fclose(s->f);
+		free(s->out);
+		free(s);
+		return NULL;
+	}
+	d->state = s;
+	d->present = file_present;
+	d->destroy = file_destroy;
+	return d;
+}
@@ -0,0 +1,62 @@
+/** DISPLAY_LED
+ *
+ * Copy the framebuffer into an offscreen canvas and swap it on vsync.
+ */
+
+#include <stdlib.h>
+#include "display_led.h"
+
+
+typedef struct {
+	struct RGBLedMatrix *matrix;
+	struct LedCanvas *canvas;
+} LedState;
+
+
+static void led_present(Display *d) {
+	LedState *s = d->state;
+	const uint8_t *p = d->pixels;
+
+	for (int y = 0; y < d->height; ++y)
+		for (int x = 0; x < d->width; ++x, p += 3)
+			led_canvas_set_pixel(s->canvas, x, y, p[0], p[1], p[2]);
+
+	/* We give swap_on_vsync the buffer we just have drawn into, and wait
+	 * until the next vsync happens. We get back the unused buffer to which
+	 * we'll draw in the next iteration. */
+	s->canvas = led_matrix_swap_on_vsync(s->matrix, s->canvas);
+}
+
+
+static void led_destroy(Display *d) {
+	free(d->state);
+	display_free(d);
+}
+
+
+/** Create a sink drawing on `matrix`, sized to its canvas. The matrix
+ * stays owned by the caller. */
+Display *led_display_create(struct RGBLedMatrix *matrix) {
+	struct LedCanvas *canvas;
+	LedState *s;
+	Display *d;
+	int width, height;
+
+	/* We use double-buffering: we have two buffers for the RGB matrix
+	 * that we swap on each update. */
+	canvas = led_matrix_create_offscreen_canvas(matrix);
+	led_canvas_get_size(canvas, &width, &height);
+
+	if ((s = calloc(1, sizeof(LedState))) == NULL)
+		return NULL;
+	if ((d = display_alloc(width, height)) == NULL) {
+		free(s);
+		return NULL;
+	}
+	s->matrix = matrix;
+	s->canvas = canvas;
+	d->state = s;
+	d->present = led_present;
+	d->destroy = led_destroy;
+	return d;
+}
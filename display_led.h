@@ -0,0 +1,16 @@
+/** DISPLAY_LED
+ *
+ * Display sink for the local RGB LED matrix.
+ */
+
+#ifndef DISPLAY_LED_H
+#define DISPLAY_LED_H
+
+#include "display.h"
+#include "led-matrix-c.h"
+
+
+/* Function declarations. */
+Display *led_display_create(struct RGBLedMatrix *matrix);
+
+#endif
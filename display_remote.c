@@ -0,0 +1,451 @@
+/** DISPLAY_REMOTE
+ *
+ * Stream frames to a remote panel driver over UDP or a Unix datagram
+ * socket, and the matching receiver.
+ *
+ * Addresses are written "udp:HOST:PORT" or "unix:PATH". A receiver binds
+ * to the address; "udp::PORT" listens on every interface.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "display.h"
+
+
+typedef struct {
+	int fd;
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	uint8_t *prev;           // last frame sent
+	bool have_prev;
+	bool send_failed;        // an error has already been reported
+	uint8_t *packet;         // header + payload
+	uint32_t seq;
+	RemoteStats stats;
+} RemoteState;
+
+struct RemoteReceiver {
+	int fd;
+	char unix_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+	uint8_t *packet;
+	uint32_t last_seq;
+	bool have_frame;
+	bool size_warned;
+	RemoteStats stats;
+};
+
+
+/** Current CLOCK_REALTIME time in nanoseconds; wall-clock time so that
+ * latency is meaningful between NTP-synchronized machines. */
+static uint64_t realtime_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+/** Open a datagram socket for `address`. Receivers (`bind_side`) bind to
+ * it; senders get the destination in `addr`. Returns -1 on error. */
+static int open_socket(const char *address, bool bind_side, struct sockaddr_storage *addr, socklen_t *addr_len) {
+	int fd;
+
+	memset(addr, 0, sizeof(*addr));
+
+	if (strncmp(address, "unix:", 5) == 0) {
+		struct sockaddr_un *un = (struct sockaddr_un *) addr;
+		const char *path = address + 5;
+
+		if (strlen(path) >= sizeof(un->sun_path)) {
+			fprintf(stderr, "remote: socket path too long: %s\n", path);
+			return -1;
+		}
+		un->sun_family = AF_UNIX;
+		strcpy(un->sun_path, path);
+		*addr_len = sizeof(struct sockaddr_un);
+
+		if ((fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+			perror("socket");
+			return -1;
+		}
+		if (bind_side) {
+			unlink(path);
+			if (bind(fd, (struct sockaddr *) un, *addr_len) < 0) {
+				perror("bind");
+				close(fd);
+				return -1;
+			}
+		}
+		return fd;
+	}
+
+	if (strncmp(address, "udp:", 4) == 0) {
+		char host[256];
+		const char *spec = address + 4;
+		const char *colon = strrchr(spec, ':');
+		struct addrinfo hints, *res;
+		int err;
+
+		if (colon == NULL || (size_t) (colon - spec) >= sizeof(host)) {
+			fprintf(stderr, "remote: expected udp:HOST:PORT, got %s\n", address);
+			return -1;
+		}
+		memcpy(host, spec, colon - spec);
+		host[colon - spec] = '\0';
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_flags = bind_side ? AI_PASSIVE : 0;
+		err = getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res);
+		if (err != 0) {
+			fprintf(stderr, "remote: cannot resolve %s (%s)\n", address, gai_strerror(err));
+			return -1;
+		}
+
+		fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+		if (fd < 0) {
+			perror("socket");
+			freeaddrinfo(res);
+			return -1;
+		}
+		if (bind_side && bind(fd, res->ai_addr, res->ai_addrlen) < 0) {
+			perror("bind");
+			close(fd);
+			freeaddrinfo(res);
+			return -1;
+		}
+		memcpy(addr, res->ai_addr, res->ai_addrlen);
+		*addr_len = res->ai_addrlen;
+		freeaddrinfo(res);
+		return fd;
+	}
+
+	fprintf(stderr, "remote: unknown address %s (use udp:HOST:PORT or unix:PATH)\n", address);
+	return -1;
+}
+
+
+/** Print and reset the statistics once per REMOTE_STATS_INTERVAL. */
+static void report_stats(RemoteStats *st, bool receiver) {
+	uint64_t now = realtime_ns();
+	double secs = (now - st->since_ns) / 1e9;
+
+	if (st->since_ns == 0) {
+		st->since_ns = now;
+		return;
+	}
+	if (secs < REMOTE_STATS_INTERVAL)
+		return;
+
+	if (st->frames > 0) {
+		fprintf(stderr, "remote %s: %.1f fps, %.1f kB/s, %.0f B/frame, %.0f%% keyframes",
+				receiver ? "receive" : "send", st->frames / secs, st->bytes / secs / 1000.0,
+				(double) st->bytes / st->frames, 100.0 * st->keyframes / st->frames);
+		if (receiver)
+			fprintf(stderr, ", latency %.2f ms mean, %.2f ms max, %llu dropped",
+					st->latency_sum_ns / 1e6 / st->frames, st->latency_max_ns / 1e6,
+					(unsigned long long) st->dropped);
+		fprintf(stderr, "\n");
+	}
+
+	memset(st, 0, sizeof(RemoteStats));
+	st->since_ns = now;
+}
+
+
+static void put_le(uint8_t *p, uint64_t v, int bytes) {
+	for (int i = 0; i < bytes; ++i)
+		p[i] = v >> (8 * i);
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+	uint64_t v = 0;
+	for (int i = 0; i < bytes; ++i)
+		v |= (uint64_t) p[i] << (8 * i);
+	return v;
+}
+
+
+/** Serialize `h` into the REMOTE_HEADER_SIZE bytes at `p`. */
+static void remote_header_write(uint8_t *p, const RemoteFrameHeader *h) {
+	put_le(p, h->magic, 4);
+	put_le(p + 4, h->version, 2);
+	put_le(p + 6, h->encoding, 2);
+	put_le(p + 8, h->width, 2);
+	put_le(p + 10, h->height, 2);
+	put_le(p + 12, h->seq, 4);
+	put_le(p + 16, h->base_seq, 4);
+	put_le(p + 20, h->timestamp_ns, 8);
+	put_le(p + 28, h->payload_len, 4);
+}
+
+/** Parse the REMOTE_HEADER_SIZE bytes at `p` into `h`. */
+static void remote_header_read(const uint8_t *p, RemoteFrameHeader *h) {
+	h->magic = get_le(p, 4);
+	h->version = get_le(p + 4, 2);
+	h->encoding = get_le(p + 6, 2);
+	h->width = get_le(p + 8, 2);
+	h->height = get_le(p + 10, 2);
+	h->seq = get_le(p + 12, 4);
+	h->base_seq = get_le(p + 16, 4);
+	h->timestamp_ns = get_le(p + 20, 8);
+	h->payload_len = get_le(p + 28, 4);
+}
+
+#define HEADER_FIELD(f) sizeof(((RemoteFrameHeader *) 0)->f)
+_Static_assert(REMOTE_HEADER_SIZE == HEADER_FIELD(magic) + HEADER_FIELD(version) +
+		HEADER_FIELD(encoding) + HEADER_FIELD(width) + HEADER_FIELD(height) +
+		HEADER_FIELD(seq) + HEADER_FIELD(base_seq) + HEADER_FIELD(timestamp_ns) +
+		HEADER_FIELD(payload_len), "REMOTE_HEADER_SIZE must match the header fields");
+
+
+/** Run-length code `prev` XOR `cur` into `out` as tokens of
+ *
+ *     u16 skip, u16 count, count XOR bytes
+ *
+ * (little endian), where `skip` bytes are unchanged. Returns the coded
+ * length, or -1 if it would exceed `out_len`. */
+int remote_encode_delta(const uint8_t *prev, const uint8_t *cur, int len, uint8_t *out, int out_len) {
+	int i = 0, o = 0;
+
+	while (i < len) {
+		int skip = 0, count = 0;
+
+		while (i + skip < len && skip < 0xffff && prev[i + skip] == cur[i + skip])
+			skip++;
+		i += skip;
+
+		/* Extend the literal run until four unchanged bytes in a row,
+		 * which are cheaper to skip than to copy. */
+		int start = i;
+		while (i < len && count < 0xffff) {
+			if (prev[i] == cur[i]) {
+				int same = 0;
+				while (i + same < len && same < 4 && prev[i + same] == cur[i + same])
+					same++;
+				if (same == 4 || i + same == len)
+					break;
+			}
+			i++;
+			count++;
+		}
+
+		if (o + 4 + count > out_len)
+			return -1;
+		out[o++] = skip & 0xff;
+		out[o++] = skip >> 8;
+		out[o++] = count & 0xff;
+		out[o++] = count >> 8;
+		for (int k = 0; k < count; ++k)
+			out[o++] = prev[start + k] ^ cur[start + k];
+	}
+	return o;
+}
+
+
+/** Apply a delta produced by `remote_encode_delta` to `frame` in place.
+ * Returns false if the delta is malformed. */
+bool remote_apply_delta(uint8_t *frame, int len, const uint8_t *delta, int delta_len) {
+	int pos = 0, d = 0;
+
+	while (d + 4 <= delta_len) {
+		int skip = delta[d] | delta[d + 1] << 8;
+		int count = delta[d + 2] | delta[d + 3] << 8;
+		d += 4;
+		pos += skip;
+		if (pos + count > len || d + count > delta_len)
+			return false;
+		for (int k = 0; k < count; ++k)
+			frame[pos + k] ^= delta[d + k];
+		pos += count;
+		d += count;
+	}
+	return d == delta_len;
+}
+
+
+static void remote_present(Display *d) {
+	RemoteState *s = d->state;
+	RemoteFrameHeader header, *h = &header;
+	uint8_t *payload = s->packet + REMOTE_HEADER_SIZE;
+	int len = d->width * d->height * 3;
+	int n = -1;
+
+	/* Send a delta when it is smaller than the raw frame, otherwise (or
+	 * every REMOTE_KEY_INTERVAL frames) a keyframe. */
+	if (s->have_prev && s->seq % REMOTE_KEY_INTERVAL != 0)
+		n = remote_encode_delta(s->prev, d->pixels, len, payload, len - 1);
+
+	h->magic = REMOTE_MAGIC;
+	h->version = REMOTE_VERSION;
+	h->width = d->width;
+	h->height = d->height;
+	h->seq = s->seq;
+	if (n >= 0) {
+		h->encoding = REMOTE_DELTA;
+		h->base_seq = s->seq - 1;
+	} else {
+		memcpy(payload, d->pixels, len);
+		n = len;
+		h->encoding = REMOTE_KEY;
+		h->base_seq = s->seq;
+		s->stats.keyframes++;
+	}
+	h->payload_len = n;
+	h->timestamp_ns = realtime_ns();
+	remote_header_write(s->packet, h);
+
+	size_t size = REMOTE_HEADER_SIZE + n;
+	if (sendto(s->fd, s->packet, size, 0, (struct sockaddr *) &s->addr, s->addr_len) < 0) {
+		// The receiver may not be up yet; report once and keep going.
+		if (!s->send_failed)
+			fprintf(stderr, "remote: send failed (%s)\n", strerror(errno));
+		s->send_failed = true;
+	} else {
+		s->send_failed = false;
+	}
+
+	memcpy(s->prev, d->pixels, len);
+	s->have_prev = true;
+	s->seq++;
+
+	s->stats.frames++;
+	s->stats.bytes += size;
+	report_stats(&s->stats, false);
+}
+
+
+static void remote_destroy(Display *d) {
+	RemoteState *s = d->state;
+	close(s->fd);
+	free(s->prev);
+	free(s->packet);
+	free(s);
+	display_free(d);
+}
+
+
+/** Create a sink that streams `width` x `height` frames to `address`. */
+Display *remote_display_create(const char *address, int width, int height) {
+	RemoteState *s;
+	Display *d;
+	int len = width * height * 3;
+
+	if (REMOTE_HEADER_SIZE + len > REMOTE_MAX_DATAGRAM) {
+		fprintf(stderr, "remote: a %dx%d frame does not fit in one datagram.\n", width, height);
+		return NULL;
+	}
+	if ((s = calloc(1, sizeof(RemoteState))) == NULL)
+		return NULL;
+	s->prev = malloc(len);
+	s->packet = calloc(1, REMOTE_HEADER_SIZE + len);
+	if (s->prev == NULL || s->packet == NULL ||
+			(s->fd = open_socket(address, false, &s->addr, &s->addr_len)) < 0) {
+		free(s->prev);
+		free(s->packet);
+		free(s);
+		return NULL;
+	}
+	if ((d = display_alloc(width, height)) == NULL) {
+		close(s->fd);
+		free(s->prev);
+		free(s->packet);
+		free(s);
+		return NULL;
+	}
+	d->state = s;
+	d->present = remote_present;
+	d->destroy = remote_destroy;
+	return d;
+}
+
+
+/** Bind to `address` and wait for frames there. */
+RemoteReceiver *remote_receiver_open(const char *address) {
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	RemoteReceiver *rx;
+
+	if ((rx = calloc(1, sizeof(RemoteReceiver))) == NULL)
+		return NULL;
+	if ((rx->packet = malloc(REMOTE_MAX_DATAGRAM)) == NULL ||
+			(rx->fd = open_socket(address, true, &addr, &addr_len)) < 0) {
+		free(rx->packet);
+		free(rx);
+		return NULL;
+	}
+	if (strncmp(address, "unix:", 5) == 0)
+		snprintf(rx->unix_path, sizeof(rx->unix_path), "%s", address + 5);
+	return rx;
+}
+
+
+/** Wait for the next datagram and apply it to `d->pixels`. Returns true
+ * when the framebuffer holds a new complete frame. */
+bool remote_receiver_next(RemoteReceiver *rx, Display *d) {
+	RemoteFrameHeader h;
+	int len = d->width * d->height * 3;
+	ssize_t n = recv(rx->fd, rx->packet, REMOTE_MAX_DATAGRAM, 0);
+	uint64_t now = realtime_ns();
+
+	if (n < REMOTE_HEADER_SIZE)
+		return false;
+	remote_header_read(rx->packet, &h);
+	if (h.magic != REMOTE_MAGIC || h.version != REMOTE_VERSION ||
+			REMOTE_HEADER_SIZE + (size_t) h.payload_len != (size_t) n)
+		return false;
+
+	if (h.width != d->width || h.height != d->height) {
+		if (!rx->size_warned)
+			fprintf(stderr, "remote: got %dx%d frames for a %dx%d display.\n",
+					h.width, h.height, d->width, d->height);
+		rx->size_warned = true;
+		return false;
+	}
+
+	const uint8_t *payload = rx->packet + REMOTE_HEADER_SIZE;
+	if (h.encoding == REMOTE_KEY && h.payload_len == (uint32_t) len) {
+		memcpy(d->pixels, payload, len);
+		rx->stats.keyframes++;
+	} else if (h.encoding == REMOTE_DELTA && rx->have_frame && h.base_seq == rx->last_seq) {
+		if (!remote_apply_delta(d->pixels, len, payload, h.payload_len)) {
+			rx->have_frame = false;
+			rx->stats.dropped++;
+			return false;
+		}
+	} else {
+		// Lost the base frame; wait for the next keyframe.
+		rx->stats.dropped++;
+		return false;
+	}
+
+	rx->have_frame = true;
+	rx->last_seq = h.seq;
+
+	uint64_t latency = now > h.timestamp_ns ? now - h.timestamp_ns : 0;
+	rx->stats.frames++;
+	rx->stats.bytes += n;
+	rx->stats.latency_sum_ns += latency;
+	if (latency > rx->stats.latency_max_ns)
+		rx->stats.latency_max_ns = latency;
+	report_stats(&rx->stats, true);
+	return true;
+}
+
+
+void remote_receiver_close(RemoteReceiver *rx) {
+	if (rx == NULL)
+		return;
+	close(rx->fd);
+	if (rx->unix_path[0])
+		unlink(rx->unix_path);
+	free(rx->packet);
+	free(rx);
+}
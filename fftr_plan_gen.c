@@ -0,0 +1,82 @@
+/** FFTR_PLAN_GEN
+ *
+ * Build-time tool: print a C source file holding read-only kiss_fftr plans
+ * (factors, twiddles and super twiddles) for every size given on the
+ * command line, so that `fftr_plan_alloc` does no trigonometry at startup.
+ *
+ *     fftr_plan_gen 1024 1600 2048 > fftr_plans_table.c
+ *
+ * The tables come from the same kiss_fft code that would compute them at
+ * run time, so prebuilt and run-time plans give identical results.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "_kiss_fft_guts.h"
+
+
+/** Print one complex table entry. %.9g round-trips a float exactly. */
+static void print_cpx(const kiss_fft_cpx *c, int last) {
+	printf("\t\t{%.9g, %.9g}%s\n", (double) c->r, (double) c->i, last ? "" : ",");
+}
+
+
+int main(int argc, char *argv[]) {
+	int n_sizes = argc - 1;
+
+	printf("/* Generated by fftr_plan_gen. Do not edit. */\n\n");
+	printf("#include \"_kiss_fft_guts.h\"\n");
+	printf("#include \"fftr_plans.h\"\n\n");
+
+	for (int a = 1; a < argc; ++a) {
+		int nfft = atoi(argv[a]);
+		int ncfft = nfft / 2;
+		kiss_fft_cfg sub;
+
+		if (nfft <= 0 || (nfft & 1)) {
+			fprintf(stderr, "fftr_plan_gen: size %s must be even and positive.\n", argv[a]);
+			return 1;
+		}
+		if ((sub = kiss_fft_alloc(ncfft, 0, NULL, NULL)) == NULL) {
+			fprintf(stderr, "fftr_plan_gen: cannot allocate plan for %d.\n", nfft);
+			return 1;
+		}
+
+		/* Same layout as struct kiss_fft_state, with the twiddle array
+		 * sized for this plan. */
+		printf("static const struct {\n");
+		printf("\tint nfft;\n\tint inverse;\n\tint factors[2 * MAXFACTORS];\n");
+		printf("\tkiss_fft_cpx twiddles[%d];\n", ncfft);
+		printf("} substate_%d = {\n", nfft);
+		printf("\t%d, 0,\n\t{", ncfft);
+		for (int i = 0; i < 2 * MAXFACTORS; ++i)
+			printf("%d%s", sub->factors[i], i + 1 < 2 * MAXFACTORS ? ", " : "");
+		printf("},\n\t{\n");
+		for (int i = 0; i < ncfft; ++i)
+			print_cpx(&sub->twiddles[i], i + 1 == ncfft);
+		printf("\t}\n};\n\n");
+
+		/* Super twiddles, computed exactly as kiss_fftr_alloc does. */
+		printf("static const kiss_fft_cpx super_twiddles_%d[%d] = {\n", nfft, ncfft / 2);
+		for (int i = 0; i < ncfft / 2; ++i) {
+			kiss_fft_cpx tw;
+			double phase =
+				-3.14159265358979323846264338327 * ((double) (i+1) / ncfft + .5);
+			kf_cexp(&tw, phase);
+			print_cpx(&tw, i + 1 == ncfft / 2);
+		}
+		printf("};\n\n");
+
+		free(sub);
+	}
+
+	printf("const FftrPlan fftr_plans[] = {\n");
+	for (int a = 1; a < argc; ++a) {
+		int nfft = atoi(argv[a]);
+		printf("\t{%d, &substate_%d, super_twiddles_%d},\n", nfft, nfft, nfft);
+	}
+	printf("\t{0, NULL, NULL}\n};\n\n");
+	printf("const int fftr_plans_count = %d;\n", n_sizes);
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+/** FFTR_PLANS
+ *
+ * Look up prebuilt real FFT plans, falling back to run-time allocation.
+ */
+
+#include "fftr_plans.h"
+
+
+/** Return the prebuilt plan for `nfft`, or NULL. */
+static const FftrPlan *find_plan(int nfft) {
+	for (int i = 0; i < fftr_plans_count; ++i)
+		if (fftr_plans[i].nfft == nfft)
+			return &fftr_plans[i];
+	return NULL;
+}
+
+
+bool fftr_plan_is_prebuilt(int nfft) {
+	return find_plan(nfft) != NULL;
+}
+
+
+/** Allocate a forward real FFT of size `nfft`. Free it with
+ * `kiss_fftr_free`, whichever path produced it. */
+kiss_fftr_cfg fftr_plan_alloc(int nfft) {
+	const FftrPlan *plan = find_plan(nfft);
+
+	if (plan != NULL)
+		return kiss_fftr_alloc_prebuilt(plan->substate, plan->super_twiddles);
+	return kiss_fftr_alloc(nfft, 0, NULL, NULL);
+}
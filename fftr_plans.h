@@ -0,0 +1,33 @@
+/** FFTR_PLANS
+ *
+ * Real FFT plans generated at build time by fftr_plan_gen for the sizes in
+ * FFT_PLAN_SIZES (see Makefile). The tables are const, so they live in the
+ * read-only part of the binary and are shared between processes through
+ * the page cache. Other sizes fall back to `kiss_fftr_alloc`.
+ */
+
+#ifndef FFTR_PLANS_H
+#define FFTR_PLANS_H
+
+#include <stdbool.h>
+#include "kiss_fftr.h"
+
+
+/* Data structures. */
+typedef struct {
+	int nfft;
+	const void *substate;                // laid out as struct kiss_fft_state
+	const kiss_fft_cpx *super_twiddles;  // nfft / 4 entries
+} FftrPlan;
+
+
+/* Generated tables. */
+extern const FftrPlan fftr_plans[];
+extern const int fftr_plans_count;
+
+
+/* Function declarations. */
+kiss_fftr_cfg fftr_plan_alloc(int nfft);
+bool fftr_plan_is_prebuilt(int nfft);
+
+#endif
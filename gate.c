@@ -0,0 +1,49 @@
+/** GATE
+ *
+ * Block level measurement and the gate state machine.
+ */
+
+#include <string.h>
+#include "gate.h"
+
+
+/** Start open, so that the display comes up as usual. */
+void idle_gate_init(IdleGate *g, float open_rms, float close_rms, int hold_blocks) {
+	memset(g, 0, sizeof(IdleGate));
+	g->open_rms = open_rms;
+	g->close_rms = close_rms < open_rms ? close_rms : open_rms;
+	g->hold_blocks = hold_blocks;
+	g->open = true;
+}
+
+
+/** Measure the `n` samples in `buf` and return whether the gate is open,
+ * i.e. whether the block should be analysed. */
+bool idle_gate_update(IdleGate *g, const short *buf, int n) {
+	int64_t sum = 0, sum_sq = 0;
+
+	for (int i = 0; i < n; ++i) {
+		sum += buf[i];
+		sum_sq += (int32_t) buf[i] * buf[i];
+	}
+
+	/* Compare variances rather than taking the square root. */
+	double mean = (double) sum / n;
+	double var = (double) sum_sq / n - mean * mean;
+
+	if (var >= (double) g->open_rms * g->open_rms) {
+		g->open = true;
+		g->quiet_blocks = 0;
+	} else if (var < (double) g->close_rms * g->close_rms) {
+		if (g->open && ++g->quiet_blocks >= g->hold_blocks) {
+			g->open = false;
+			g->closings++;
+		}
+	} else {
+		g->quiet_blocks = 0;
+	}
+
+	if (!g->open)
+		g->idle_blocks++;
+	return g->open;
+}
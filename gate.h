@@ -0,0 +1,37 @@
+/** GATE
+ *
+ * Silence gate on the captured blocks. While the room is quiet, vmatrix
+ * skips the FFT and stops redrawing, holding the last frame, so an idle
+ * installation costs little more than the sound card wake-ups.
+ *
+ * The gate measures the RMS of each block around its own mean, so a DC
+ * offset from the microphone does not keep it open. It opens as soon as
+ * one block reaches `open_rms`. It closes only after `hold_blocks` blocks
+ * in a row stay below `close_rms`, which keeps it from chattering around
+ * the threshold or closing in short pauses.
+ */
+
+#ifndef GATE_H
+#define GATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Data structures. */
+typedef struct {
+	float open_rms;         // sample units
+	float close_rms;        // sample units, at most `open_rms`
+	int hold_blocks;
+	bool open;
+	int quiet_blocks;       // consecutive blocks below `close_rms`
+	uint64_t idle_blocks;   // blocks skipped while closed
+	uint64_t closings;
+} IdleGate;
+
+
+/* Function declarations. */
+void idle_gate_init(IdleGate *g, float open_rms, float close_rms, int hold_blocks);
+bool idle_gate_update(IdleGate *g, const short *buf, int n);
+
+#endif
@@ -1,27 +1,190 @@
 /** Generator.
- * 
+ *
  * Generate waveform data and write it to `stdout`.
+ *
+ * By default one text sample is written per line at roughly `FS` Hz. With
+ * `-b` the generator switches to block mode and writes raw native-endian
+ * int16 PCM in large blocks from the deterministic signal library in
+ * signals.c:
+ *
+ *     generator -b [-r rate] [-n frames] [-u] [-s signal] [-f freq]...
+ *               [-S seed] [-p period]
+ *
+ * `signal` is one of tones (default, 440 + 4400 Hz), sweep, white, pink,
+ * impulse or burst. `-f` adds a tone (up to SIGNAL_MAX_TONES), `-S` sets
+ * the noise seed and `-p` the impulse / burst period in seconds.
+ *
+ * Block mode paces itself against an absolute CLOCK_MONOTONIC deadline so
+ * that timing error does not accumulate, or runs unthrottled with `-u`
+ * for load testing.
  */
 
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
+#include <time.h>
 #include <unistd.h>
+#include "signals.h"
 
 #define FS 10000.0  // simulated sampling rate
 #define SCALE 10000.0  // max (and min) value output value
 #define SLEEP_INTERVAL (1 / FS)*1000000
 
+#define BLOCK_RATE 44100    // default block-mode sampling rate
+#define BLOCK_FRAMES 1024   // default samples per block
+#define BLOCK_TONE_LOW 440.0    // Hz, default block-mode tones (same 1:10
+#define BLOCK_TONE_HIGH 4400.0  // ratio as the text-mode signal)
+
+
 /** Generate data point. */
 long generate_sine(long x) {
 	double zzz = sin(((double) x) / FS);
 	double yyy = cos((((double) x) * 10) / FS);
 
-	// Scale generated value 
+	// Scale generated value
 	return (long) ((zzz + yyy) * SCALE);
 }
 
+
+/** Write all of `buf` to `stdout`, retrying on short writes. */
+int write_all(const void *buf, size_t len) {
+	const char *p = buf;
+	while (len > 0) {
+		ssize_t n = write(STDOUT_FILENO, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+
+/** Advance `t` by `ns` nanoseconds. */
+void timespec_add_ns(struct timespec *t, long long ns) {
+	ns += t->tv_nsec;
+	t->tv_sec += ns / 1000000000;
+	t->tv_nsec = ns % 1000000000;
+}
+
+
+/** Write raw int16 PCM blocks to `stdout` until the reader goes away. */
+int run_block_mode(Signal *signal, int rate, int frames, int throttle) {
+	struct timespec deadline;
+	int16_t *block;
+	float *samples;
+	long long blocks = 0;
+
+	block = malloc(frames * sizeof(int16_t));
+	samples = malloc(frames * sizeof(float));
+	if (block == NULL || samples == NULL) {
+		fprintf(stderr, "Error allocating memory for sample block.\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	for (;;) {
+		signal_fill(signal, samples, frames);
+		for (int i = 0; i < frames; ++i) {
+			float v = samples[i];
+			if (v > 1.0f) v = 1.0f;
+			if (v < -1.0f) v = -1.0f;
+			block[i] = (int16_t) (v * 32767.0f);
+		}
+
+		if (write_all(block, frames * sizeof(int16_t)) < 0)
+			break;
+		blocks++;
+
+		/* Sleep until the absolute time at which the next block is due,
+		 * computed from the block count so rounding never drifts. Whole
+		 * seconds are added separately, so the nanoseconds cannot
+		 * overflow however long the generator runs. */
+		if (throttle) {
+			struct timespec next = deadline;
+			long long written = blocks * frames;
+			next.tv_sec += written / rate;
+			timespec_add_ns(&next, written % rate * 1000000000LL / rate);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+				;
+		}
+	}
+
+	free(samples);
+	free(block);
+	return 0;
+}
+
+
 int main(int argc, char *argv[]) {
 	long counter = 0;
+	int block_mode = 0;
+	int throttle = 1;
+	int rate = BLOCK_RATE;
+	int frames = BLOCK_FRAMES;
+	int type = SIGNAL_TONES;
+	double freqs[SIGNAL_MAX_TONES];
+	int n_freqs = 0;
+	double period = 0;
+	unsigned long long seed = SIGNAL_DEFAULT_SEED;
+	Signal signal;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "br:n:us:f:S:p:")) != -1) {
+		switch (opt) {
+			case 'b':
+				block_mode = 1; break;
+			case 'r':
+				rate = atoi(optarg); break;
+			case 'n':
+				frames = atoi(optarg); break;
+			case 'u':
+				throttle = 0; break;
+			case 's':
+				if ((type = signal_type_from_name(optarg)) < 0) {
+					fprintf(stderr, "Unknown signal %s.\n", optarg);
+					return 1;
+				}
+				break;
+			case 'f':
+				if (n_freqs < SIGNAL_MAX_TONES)
+					freqs[n_freqs++] = atof(optarg);
+				break;
+			case 'S':
+				seed = strtoull(optarg, NULL, 0); break;
+			case 'p':
+				period = atof(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-b [-r rate] [-n frames] [-u] [-s signal] "
+						"[-f freq]... [-S seed] [-p period]]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (block_mode) {
+		if (rate <= 0 || frames <= 0) {
+			fprintf(stderr, "Rate and block size must be greater than 0.\n");
+			return 1;
+		}
+
+		signal_init(&signal, type, rate, seed);
+		if (n_freqs == 0 && type == SIGNAL_TONES) {
+			freqs[n_freqs++] = BLOCK_TONE_LOW;
+			freqs[n_freqs++] = BLOCK_TONE_HIGH;
+		}
+		for (int i = 0; i < n_freqs; ++i)
+			signal_add_tone(&signal, freqs[i]);
+		if (period > 0)
+			signal_set_period(&signal, period, period / 10.0);
+
+		return run_block_mode(&signal, rate, frames, throttle);
+	}
 
 	for (;;) {
 		fprintf(stdout, "%ld\n", generate_sine(counter));
@@ -382,6 +382,36 @@ void kiss_fft(kiss_fft_cfg cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout)
 }
 
 
+int kiss_fft_decimated(kiss_fft_cfg st,const kiss_fft_cpx *fin,kiss_fft_cpx *fout,int nout)
+{
+    /* Dropping the first s stages saves about nfft butterfly outputs per
+     * stage and costs q_s - 1 complex multiply-adds per wanted output. */
+    long cost, best_cost;
+    int s, stages = 0, depth = 0, q = 1, best_q = 1, j, m;
+
+    while (st->factors[2*stages+1] > 1)
+        ++stages;
+    best_cost = (long) st->nfft * (stages + 1);
+    for (s = 1; s <= stages; ++s) {
+        q *= st->factors[2*(s-1)];
+        cost = (long) st->nfft * (stages + 1 - s) + (long) nout * (q - 1);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_q = q;
+            depth = s;
+        }
+    }
+
+    if (depth == 0) {
+        kiss_fft_stride(st,fin,fout,1);
+        return 1;
+    }
+    m = st->nfft / best_q;
+    for (j = 0; j < best_q; ++j)
+        kf_work( fout + j*m, fin + j, best_q, 1, st->factors + 2*depth, st );
+    return best_q;
+}
+
 void kiss_fft_cleanup(void)
 {
     // nothing needed any more
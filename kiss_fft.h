@@ -105,6 +105,19 @@ void kiss_fft(kiss_fft_cfg cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout);
  * */
 void kiss_fft_stride(kiss_fft_cfg cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout,int fin_stride);
 
+/*
+ First half of an output-pruned FFT, for callers that need only `nout` of
+ the nfft outputs. The leading radix stages are dropped and the remaining
+ ones run on the q decimated inputs f[j], f[j+q], ... for j = 0..q-1,
+ leaving their nfft/q-point transforms one after another in fout:
+
+     F[k] = sum over j of twiddles[j*k mod nfft] * fout[j*nfft/q + k mod nfft/q]
+
+ q is chosen so the dropped stages cost more than those sums for `nout`
+ outputs, and is returned; q == 1 means fout is the full transform.
+ * */
+int kiss_fft_decimated(kiss_fft_cfg cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout,int nout);
+
 /* If kiss_fft_alloc allocated a buffer, it is one contiguous 
    buffer and can be simply free()d when no longer needed*/
 #define kiss_fft_free KISS_FFT_FREE
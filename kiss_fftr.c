@@ -58,6 +58,23 @@ kiss_fftr_cfg kiss_fftr_alloc(int nfft,int inverse_fft,void * mem,size_t * lenme
     return st;
 }
 
+kiss_fftr_cfg kiss_fftr_alloc_prebuilt(const void * substate,const kiss_fft_cpx * super_twiddles)
+{
+    /* The complex sub-FFT state and the super twiddles are read-only tables
+     * generated ahead of time; only the scratch buffer is allocated here. */
+    const struct kiss_fft_state * sub = (const struct kiss_fft_state *) substate;
+    kiss_fftr_cfg st;
+
+    st = (kiss_fftr_cfg) KISS_FFT_MALLOC (sizeof(struct kiss_fftr_state) + sizeof(kiss_fft_cpx) * sub->nfft);
+    if (!st)
+        return NULL;
+
+    st->substate = (kiss_fft_cfg) sub;
+    st->tmpbuf = (kiss_fft_cpx *) (st + 1);
+    st->super_twiddles = (kiss_fft_cpx *) super_twiddles;
+    return st;
+}
+
 void kiss_fftr(kiss_fftr_cfg st,const kiss_fft_scalar *timedata,kiss_fft_cpx *freqdata)
 {
     /* input buffer timedata is stored row-wise */
@@ -114,6 +131,111 @@ void kiss_fftr(kiss_fftr_cfg st,const kiss_fft_scalar *timedata,kiss_fft_cpx *fr
     }
 }
 
+/* Output j of the complex sub-FFT, from the q decimated transforms that
+ * kiss_fft_decimated left in tmpbuf. */
+static kiss_fft_cpx kf_pruned_output(kiss_fftr_cfg st,int q,int j)
+{
+    int n, ncfft = st->substate->nfft, m = ncfft / q, twidx = 0;
+    const kiss_fft_cpx * sub = st->tmpbuf + j % m;
+    kiss_fft_cpx acc, sn, t;
+
+    acc = sub[0];
+    C_FIXDIV(acc,q);
+    for (n = 1; n < q; ++n) {
+        twidx += j;
+        if (twidx >= ncfft) twidx -= ncfft;
+        sn = sub[n*m];
+        C_FIXDIV(sn,q);
+        C_MUL(t, sn, st->substate->twiddles[twidx]);
+        C_ADDTO(acc, t);
+    }
+    return acc;
+}
+
+void kiss_fftr_pruned(kiss_fftr_cfg st,const kiss_fft_scalar *timedata,kiss_fft_cpx *freqdata,int kmin,int kmax)
+{
+    int k,ncfft,q;
+    kiss_fft_cpx fpnk,fpk,f1k,f2k,tw,tdc;
+
+    if ( st->substate->inverse) {
+        fprintf(stderr,"kiss fft usage error: improper alloc\n");
+        exit(1);
+    }
+
+    ncfft = st->substate->nfft;
+    if (kmin < 0)
+        kmin = 0;
+    if (kmax > ncfft / 2) {
+        kiss_fftr(st, timedata, freqdata);
+        return;
+    }
+    if (kmin > kmax)
+        return;
+
+    /* Output k needs sub-FFT outputs k and ncfft-k. */
+    q = kiss_fft_decimated( st->substate, (const kiss_fft_cpx*)timedata, st->tmpbuf,
+            2 * (kmax - kmin + 1) );
+
+    for ( k=kmin;k <= kmax ; ++k ) {
+        if (k == 0) {
+            tdc = kf_pruned_output(st, q, 0);
+            C_FIXDIV(tdc,2);
+            CHECK_OVERFLOW_OP(tdc.r ,+, tdc.i);
+            freqdata[0].r = tdc.r + tdc.i;
+#ifdef USE_SIMD    
+            freqdata[0].i = _mm_set1_ps(0);
+#else
+            freqdata[0].i = 0;
+#endif
+            continue;
+        }
+        fpk    = kf_pruned_output(st, q, k);
+        fpnk   = kf_pruned_output(st, q, ncfft-k);
+        fpnk.i = - fpnk.i;
+        C_FIXDIV(fpk,2);
+        C_FIXDIV(fpnk,2);
+
+        C_ADD( f1k, fpk , fpnk );
+        C_SUB( f2k, fpk , fpnk );
+        C_MUL( tw , f2k , st->super_twiddles[k-1]);
+
+        freqdata[k].r = HALF_OF(f1k.r + tw.r);
+        freqdata[k].i = HALF_OF(f1k.i + tw.i);
+    }
+}
+
+void kiss_fft_real_pair(kiss_fft_cfg cfg,const kiss_fft_scalar *a,const kiss_fft_scalar *b,
+                        kiss_fft_cpx *freqa,kiss_fft_cpx *freqb,kiss_fft_cpx *scratch)
+{
+    int k, nfft = cfg->nfft;
+    kiss_fft_cpx * packed = scratch;
+    kiss_fft_cpx * z = scratch + nfft;
+    kiss_fft_cpx zk, znk;
+
+    if (cfg->inverse) {
+        fprintf(stderr,"kiss fft usage error: improper alloc\n");
+        exit(1);
+    }
+
+    for (k = 0; k < nfft; ++k) {
+        packed[k].r = a[k];
+        packed[k].i = b[k];
+    }
+    kiss_fft(cfg, packed, z);
+
+    /* With Z = A + iB for real a and b:
+     *     A[k] = (Z[k] + conj(Z[nfft-k])) / 2
+     *     B[k] = (Z[k] - conj(Z[nfft-k])) / 2i */
+    for (k = 0; k <= nfft / 2; ++k) {
+        zk = z[k];
+        znk = z[k == 0 ? 0 : nfft - k];
+        freqa[k].r = HALF_OF(zk.r + znk.r);
+        freqa[k].i = HALF_OF(zk.i - znk.i);
+        freqb[k].r = HALF_OF(zk.i + znk.i);
+        freqb[k].i = HALF_OF(znk.r - zk.r);
+    }
+}
+
 void kiss_fftri(kiss_fftr_cfg st,const kiss_fft_cpx *freqdata,kiss_fft_scalar *timedata)
 {
     /* input buffer timedata is stored row-wise */
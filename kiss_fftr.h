@@ -33,6 +33,13 @@ kiss_fftr_cfg kiss_fftr_alloc(int nfft,int inverse_fft,void * mem, size_t * lenm
  If you don't care to allocate space, use mem = lenmem = NULL 
 */
 
+kiss_fftr_cfg kiss_fftr_alloc_prebuilt(const void * substate,const kiss_fft_cpx * super_twiddles);
+/*
+ Build a forward real FFT from prebuilt read-only tables: `substate` laid
+ out as a kiss_fft_state for nfft/2, and nfft/4 super twiddles. Only the
+ scratch buffer is allocated; free the result with kiss_fftr_free.
+*/
+
 
 void kiss_fftr(kiss_fftr_cfg cfg,const kiss_fft_scalar *timedata,kiss_fft_cpx *freqdata);
 /*
@@ -40,6 +47,25 @@ void kiss_fftr(kiss_fftr_cfg cfg,const kiss_fft_scalar *timedata,kiss_fft_cpx *f
  output freqdata has nfft/2+1 complex points
 */
 
+void kiss_fftr_pruned(kiss_fftr_cfg cfg,const kiss_fft_scalar *timedata,kiss_fft_cpx *freqdata,int kmin,int kmax);
+/*
+ As kiss_fftr, but only freqdata[kmin..kmax] are computed; the other
+ outputs are left undefined. Butterflies and post-twiddles that feed only
+ unused outputs are skipped, which pays off for a narrow low band. Ranges
+ reaching above nfft/4 fall back to the full transform, which writes
+ every output.
+*/
+
+void kiss_fft_real_pair(kiss_fft_cfg cfg,const kiss_fft_scalar *a,const kiss_fft_scalar *b,
+                        kiss_fft_cpx *freqa,kiss_fft_cpx *freqb,kiss_fft_cpx *scratch);
+/*
+ Spectra of two real frames of nfft points from one complex FFT: `a` is
+ packed into the real parts and `b` into the imaginary parts, and the
+ two halves are separated by conjugate symmetry. `cfg` is a forward
+ complex plan for nfft (not nfft/2) points and `scratch` holds 2*nfft
+ points. freqa and freqb get nfft/2+1 points each, as from kiss_fftr.
+*/
+
 void kiss_fftri(kiss_fftr_cfg cfg,const kiss_fft_cpx *freqdata,kiss_fft_scalar *timedata);
 /*
  input freqdata has  nfft/2+1 complex points
@@ -0,0 +1,202 @@
+/** LATENCY
+ *
+ * Paced burst source, detecting sink and the latency report.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "latency.h"
+#include "pipeline.h"
+
+
+/** xorshift64, for placing the bursts. */
+static uint64_t rng_next(uint64_t *state) {
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+
+/** Place the next burst `interval` samples after `after`, at a random
+ * offset within its block so that every phase against the block
+ * boundaries is measured. */
+static void schedule_burst(LatencyProbe *p, uint64_t after) {
+	uint64_t block = (after + p->interval) / p->block;
+	p->next_burst = block * p->block + rng_next(&p->rng) % (p->block - LATENCY_BURST + 1);
+}
+
+
+static int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+
+/** Send `impulses` bursts, `interval` seconds apart, in blocks of `block`
+ * samples at `rate` Hz. The first comes after one interval of silence.
+ * Set the burst frequency with `latency_probe_set_tone` before reading. */
+bool latency_probe_init(LatencyProbe *p, int rate, int block, float interval, int impulses) {
+	memset(p, 0, sizeof(LatencyProbe));
+	if (block <= LATENCY_BURST) {
+		fprintf(stderr, "latency: blocks must be longer than %d samples.\n", LATENCY_BURST);
+		return false;
+	}
+	p->rate = rate;
+	p->block = block;
+	p->impulses = impulses;
+	p->interval = interval * rate;
+	p->rng = 0x9e3779b97f4a7c15ull;
+	if ((p->latencies_ns = calloc(impulses, sizeof(uint64_t))) == NULL) {
+		fprintf(stderr, "latency: out of memory.\n");
+		return false;
+	}
+	schedule_burst(p, 0);
+	return true;
+}
+
+
+void latency_probe_free(LatencyProbe *p) {
+	free(p->latencies_ns);
+	free(p->previous);
+	free(p->reference);
+	p->latencies_ns = NULL;
+	p->previous = p->reference = NULL;
+}
+
+
+/** Tune the bursts to `hz`, which should fall inside the displayed band. */
+void latency_probe_set_tone(LatencyProbe *p, double hz) {
+	p->tone_hz = hz;
+}
+
+
+/** Deliver the next block into `buf` once it would have been recorded, as
+ * a blocking read from the sound card does. Returns false once every
+ * burst has been sent and given one interval to show up. */
+bool latency_probe_read(LatencyProbe *p, short *buf) {
+	uint64_t first = p->blocks * p->block;
+
+	if (p->sent >= p->impulses && first >= p->next_burst)
+		return false;
+	if (p->blocks == 0)
+		p->start_ns = monotonic_ns();
+
+	/* Real time: the block is complete when its last sample is in. After
+	 * a stall, blocks come back to back until the source has caught up,
+	 * like audio buffered by the driver. */
+	uint64_t due_ns = p->start_ns + (first + p->block) * 1000000000ull / p->rate;
+	struct timespec ts = {
+		.tv_sec = due_ns / 1000000000ull,
+		.tv_nsec = due_ns % 1000000000ull,
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+
+	memset(buf, 0, p->block * sizeof(short));
+	if (p->sent < p->impulses && p->next_burst < first + p->block) {
+		short *burst = buf + (p->next_burst - first);
+		for (int i = 0; i < LATENCY_BURST; ++i)
+			burst[i] = LATENCY_AMPLITUDE * sinf(2 * M_PI * p->tone_hz * i / p->rate);
+
+		/* A burst the sink has not answered yet is lost. */
+		uint64_t burst_ns = p->start_ns + p->next_burst * 1000000000ull / p->rate;
+		if (atomic_exchange(&p->pending_ns, burst_ns) != 0)
+			atomic_fetch_add(&p->missed, 1);
+		p->sent++;
+		schedule_burst(p, p->next_burst);
+	}
+
+	p->blocks++;
+	return true;
+}
+
+
+/** Number of pixels that differ between two frames of `n` pixels. */
+static int changed_pixels(const uint8_t *a, const uint8_t *b, int n) {
+	int changed = 0;
+
+	for (int i = 0; i < n; ++i)
+		changed += a[3 * i] != b[3 * i] || a[3 * i + 1] != b[3 * i + 1] ||
+				a[3 * i + 2] != b[3 * i + 2];
+	return changed;
+}
+
+
+/** Arm on the first frame after a burst was sent, if the display was
+ * still, and answer it with the first frame that differs from the one
+ * shown before. */
+static void latency_present(Display *d) {
+	LatencyProbe *p = d->state;
+	int n = d->width * d->height;
+	size_t size = (size_t) n * 3;
+	uint64_t now_ns = monotonic_ns();
+	uint64_t burst_ns = atomic_load(&p->pending_ns);
+
+	if (burst_ns != 0 && burst_ns != p->armed_ns) {
+		p->armed_ns = burst_ns;
+		p->armed = p->settled;
+		memcpy(p->reference, p->previous, size);
+	}
+	if (p->armed && changed_pixels(d->pixels, p->reference, n) >= LATENCY_PIXELS &&
+			atomic_compare_exchange_strong(&p->pending_ns, &burst_ns, 0)) {
+		if (p->answered < p->impulses)
+			p->latencies_ns[p->answered++] = now_ns - burst_ns;
+		p->armed = false;
+	}
+
+	p->settled = changed_pixels(d->pixels, p->previous, n) == 0;
+	memcpy(p->previous, d->pixels, size);
+}
+
+
+static void latency_destroy(Display *d) {
+	display_free(d);
+}
+
+
+/** Create the headless sink that answers the bursts of `p`. */
+Display *latency_display_create(LatencyProbe *p, int width, int height) {
+	Display *d;
+
+	if ((d = display_alloc(width, height)) == NULL)
+		return NULL;
+	p->previous = calloc((size_t) width * height, 3);
+	p->reference = calloc((size_t) width * height, 3);
+	if (p->previous == NULL || p->reference == NULL) {
+		display_free(d);
+		return NULL;
+	}
+	d->present = latency_present;
+	d->destroy = latency_destroy;
+	d->state = p;
+	return d;
+}
+
+
+/** Print the latency distribution, labelled with `config`. */
+void latency_probe_report(LatencyProbe *p, const char *config) {
+	int n = p->answered;
+	int missed = atomic_load(&p->missed) + (atomic_load(&p->pending_ns) != 0);
+
+	if (n == 0) {
+		printf("latency %s: no burst reached the display, %d missed\n", config, missed);
+		return;
+	}
+
+	uint64_t *ns = p->latencies_ns;
+	double sum = 0;
+	qsort(ns, n, sizeof(uint64_t), compare_u64);
+	for (int i = 0; i < n; ++i)
+		sum += ns[i];
+
+	printf("latency %s: %d bursts, %d missed; ms min %.1f median %.1f "
+			"p90 %.1f p99 %.1f max %.1f mean %.1f\n", config, n, missed,
+			ns[0] / 1e6, ns[n / 2] / 1e6, ns[n * 9 / 10] / 1e6,
+			ns[n * 99 / 100] / 1e6, ns[n - 1] / 1e6, sum / n / 1e6);
+}
@@ -0,0 +1,73 @@
+/** LATENCY
+ *
+ * Loopback harness for the audio-to-pixel latency. A synthetic source
+ * stands in for the sound card: it delivers silent blocks at the sampling
+ * rate, as a blocking ALSA read would, with a short tone burst every
+ * `interval` seconds at a random offset within its block. The burst is
+ * tuned to the middle of the band the views show, which depends on the
+ * block size and the layout. A headless display sink keeps the frame
+ * shown when the burst was sent and takes the first frame that differs
+ * from it as the answer. Comparing whole frames works for every display
+ * mode, including the hollow histogram, which only moves one pixel per
+ * column.
+ *
+ * The latency of a burst runs from the time its first sample would have
+ * reached the microphone to the return of `display_present` for the frame
+ * that shows it, so it covers the rest of the block, the queues, analysis,
+ * the render clock and drawing. The panel's own refresh is not included.
+ *
+ * A burst sent while the display is still moving, or that never changes
+ * it before the next burst, is counted as missed.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "display.h"
+
+#define LATENCY_BURST 256        // samples per tone burst
+#define LATENCY_AMPLITUDE 20000  // burst peak, in sample units
+#define LATENCY_PIXELS 1         // changed pixels that count as a response
+
+
+/* Data structures. */
+typedef struct {
+	int rate;                   // Hz
+	int block;                  // samples per block
+	int impulses;               // bursts to send
+	uint64_t interval;          // samples between bursts
+	uint64_t start_ns;          // delivery time of sample 0
+	uint64_t blocks;            // blocks delivered
+	uint64_t next_burst;        // sample index of the next burst
+	int sent;
+	uint64_t rng;
+	double tone_hz;             // burst frequency
+
+	/* Burst awaiting a response, 0 for none; set by the source, taken by
+	 * the sink, which may run on another thread. */
+	_Atomic uint64_t pending_ns;
+
+	/* Sink side. */
+	uint8_t *previous;          // last frame presented
+	uint8_t *reference;         // frame shown when the armed burst was sent
+	bool settled;               // the last two frames were the same
+	uint64_t armed_ns;          // burst being watched for
+	bool armed;                 // the display was still when it was sent
+	uint64_t *latencies_ns;     // one per answered burst
+	int answered;
+	atomic_int missed;
+} LatencyProbe;
+
+
+/* Function declarations. */
+bool latency_probe_init(LatencyProbe *p, int rate, int block, float interval, int impulses);
+void latency_probe_free(LatencyProbe *p);
+void latency_probe_set_tone(LatencyProbe *p, double hz);
+bool latency_probe_read(LatencyProbe *p, short *buf);
+Display *latency_display_create(LatencyProbe *p, int width, int height);
+void latency_probe_report(LatencyProbe *p, const char *config);
+
+#endif
@@ -0,0 +1,94 @@
+/** LAYOUT
+ *
+ * Viewport setup and per-view binning for composited layouts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "layout.h"
+
+
+/** Set up the views in `views` on a `panel_width` x `panel_height` panel
+ * and allocate their renderer state. */
+bool layout_init(Layout *l, View *views, int n_views, int panel_width, int panel_height) {
+	l->views = views;
+	l->n_views = n_views;
+	l->bins_size = 0;
+
+	for (int i = 0; i < n_views; ++i) {
+		View *v = &views[i];
+
+		if (v->width == 0)
+			v->width = panel_width - v->x;
+		if (v->height == 0)
+			v->height = panel_height - v->y;
+		if (v->x < 0 || v->y < 0 || v->width <= 0 || v->height <= 0 ||
+				v->x + v->width > panel_width ||
+				v->y + v->height > panel_height) {
+			fprintf(stderr, "layout: view %d does not fit on the %dx%d panel.\n",
+					i, panel_width, panel_height);
+			return false;
+		}
+
+		/* The spectrogram bins over its height at half the resolution of
+		 * the histograms, which bin over their width. It keeps one column
+		 * more than it shows so that it can scroll by part of a column,
+		 * on every level of its history. */
+		if (v->mode == SCROLLING_SPECTROGRAM) {
+			if (v->zoom < 0 || v->zoom >= SPECTROGRAM_OCTAVES) {
+				fprintf(stderr, "layout: view %d zoom must be 0 to %d.\n",
+						i, SPECTROGRAM_OCTAVES - 1);
+				return false;
+			}
+			v->size = v->height;
+			v->bin_size = 2;
+			v->history = calloc((size_t) (v->zoom + 1) * (v->width + 1) * v->height,
+					sizeof(SpectrogramLevel));
+			if (v->history == NULL)
+				return false;
+		} else {
+			v->size = v->width;
+			v->bin_size = 1;
+			if ((v->columns = column_state_alloc(v->width)) == NULL)
+				return false;
+		}
+		if (v->bin_size > 1 && (v->bins = calloc(v->size, sizeof(float))) == NULL)
+			return false;
+
+		/* Value `x` averages shared bins (x + 1) * bin_size - 1 onwards. */
+		int needed = (v->size + 1) * v->bin_size - 1;
+		if (needed > l->bins_size)
+			l->bins_size = needed;
+	}
+	return true;
+}
+
+
+void layout_free(Layout *l) {
+	for (int i = 0; i < l->n_views; ++i) {
+		View *v = &l->views[i];
+		free(v->bins);
+		free(v->history);
+		column_state_free(v->columns);
+		v->bins = NULL;
+		v->history = NULL;
+		v->columns = NULL;
+	}
+}
+
+
+/** Return the view's values for this frame, taken from the `shared` bins
+ * produced by the analysis stage. */
+float *view_bins(View *v, const float *shared) {
+	if (v->bin_size == 1)
+		return (float *) shared;
+
+	for (int x = 0; x < v->size; ++x) {
+		const float *src = shared + (x + 1) * v->bin_size - 1;
+		float sum = 0;
+		for (int b = 0; b < v->bin_size; ++b)
+			sum += src[b];
+		v->bins[x] = sum / v->bin_size;
+	}
+	return v->bins;
+}
@@ -0,0 +1,88 @@
+/** LAYOUT
+ *
+ * Several views composited into one frame. Every view owns a viewport on
+ * the panel and the per-view state of its renderer (scrolling history or
+ * histogram columns), but all views are fed from the same analysis pass:
+ * the analysis stage bins the spectrum once into `bins_size` shared bins,
+ * and each view picks its values out of that array when it is drawn.
+ *
+ * A view with `bin_size` 1 reads the shared bins directly; coarser views
+ * average `bin_size` neighbours into their own small buffer.
+ *
+ * Spectrogram history holds palette indices, quantized once when a column
+ * is added, so drawing is a table lookup and long scrollback stays small.
+ * It is kept as a pyramid of levels of one view width each: level 0 has
+ * one column per spectrum, and every level above pools pairs of columns of
+ * the one below, so level k spans 2^k times as long. A view keeps levels
+ * 0 to `zoom` and draws the top one, at the same cost whatever span it
+ * shows. A column is added to level k every 2^k spectra, which costs
+ * about two level-0 updates per spectrum in all.
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "columns.h"
+#include "display.h"
+
+#define SPECTROGRAM_BITS 8  // bits per spectrogram history entry, 8 or 16
+#define SPECTROGRAM_OCTAVES 12  // most history levels, each twice as long as the one below
+
+#if SPECTROGRAM_BITS > 8
+typedef uint16_t SpectrogramLevel;
+#else
+typedef uint8_t SpectrogramLevel;
+#endif
+#define SPECTROGRAM_LEVELS (1 << (8 * sizeof(SpectrogramLevel)))
+
+
+/* Display modes. */
+typedef enum {
+	HISTOGRAM,
+	HISTOGRAM_HOLLOW,
+	HISTOGRAM_W_ENVELOPE,
+	SCROLLING_SPECTROGRAM
+} DisplayMode;
+
+
+/* Data structures. */
+struct RenderKernels;
+
+typedef struct {
+	DisplayMode mode;
+	int x, y;               // top-left corner on the panel
+	int width, height;      // 0 extends the view to the panel edge
+	int size;               // values the view draws per frame
+	int bin_size;           // shared bins averaged into each value
+	float *bins;            // the view's values when `bin_size` > 1
+	int zoom;               // SCROLLING_SPECTROGRAM: each column pools 2^zoom spectra
+	SpectrogramLevel *history;  // SCROLLING_SPECTROGRAM: zoom + 1 octaves of (width + 1) * height levels
+	uint64_t spectra;       // SCROLLING_SPECTROGRAM: spectra added to the history
+	ColumnState *columns;   // histogram modes
+	const struct RenderKernels *kernels;  // render loops for this size, set by the renderer
+} View;
+
+typedef struct {
+	View *views;
+	int n_views;
+	int bins_size;          // shared bins needed by the widest view
+} Layout;
+
+
+/* Function declarations. */
+bool layout_init(Layout *l, View *views, int n_views, int panel_width, int panel_height);
+void layout_free(Layout *l);
+float *view_bins(View *v, const float *shared);
+
+
+/** Set one pixel in view coordinates; pixels outside the viewport are
+ * ignored so that views never draw over each other. */
+static inline void view_set_pixel(Display *d, const View *v, int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+	if (x < 0 || y < 0 || x >= v->width || y >= v->height)
+		return;
+	display_set_pixel(d, v->x + x, v->y + y, r, g, b);
+}
+
+#endif
@@ -0,0 +1,106 @@
+/** ONSET
+ *
+ * Spectral-flux onset and beat detector.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "onset.h"
+
+#define BEAT_PERIOD_MIN 8    // frames; faster "beats" are not tracked (~200 BPM)
+#define BEAT_PERIOD_MAX 60   // frames; slower ones restart tracking (~27 BPM)
+
+
+bool onset_init(OnsetDetector *od, int n_bins, int beat_bins, float sensitivity, int refractory) {
+	memset(od, 0, sizeof(OnsetDetector));
+	od->n_bins = n_bins;
+	od->beat_bins = beat_bins < n_bins ? beat_bins : n_bins;
+	od->sensitivity = sensitivity;
+	od->refractory = refractory;
+	od->full.since_event = refractory;
+	od->low.since_event = refractory;
+	return (od->prev = calloc(n_bins, sizeof(float))) != NULL;
+}
+
+
+/** Push `flux` into the band's window and report whether it stands out.
+ * The test runs against the window before `flux` is added. */
+static bool band_update(OnsetDetector *od, FluxBand *b, float flux) {
+	bool event = false;
+
+	if (od->filled >= ONSET_MIN_FRAMES) {
+		double mean = b->sum / od->filled;
+		double var = b->sum_sq / od->filled - mean * mean;
+		double threshold = mean + od->sensitivity * sqrt(var > 0 ? var : 0);
+		event = flux > threshold && flux > 0 && b->since_event >= od->refractory;
+	}
+
+	if (od->filled == ONSET_WINDOW) {
+		float old = b->flux[od->pos];
+		b->sum -= old;
+		b->sum_sq -= (double) old * old;
+	}
+	b->flux[od->pos] = flux;
+	b->sum += flux;
+	b->sum_sq += (double) flux * flux;
+
+	b->since_event = event ? 0 : b->since_event + 1;
+	return event;
+}
+
+
+/** Feed one frame of `n_bins` magnitudes. Returns ONSET_EVENT and/or
+ * BEAT_EVENT bits. */
+uint32_t onset_update(OnsetDetector *od, const float *amplitudes) {
+	float full = 0, low = 0;
+	uint32_t events = 0;
+
+	/* Half-wave rectified difference: only rising energy counts. The DC
+	 * bin is skipped. */
+	for (int k = 1; k < od->n_bins; ++k) {
+		float d = amplitudes[k] - od->prev[k];
+		d = d > 0 ? d : 0;
+		full += d;
+		if (k < od->beat_bins)
+			low += d;
+	}
+	memcpy(od->prev, amplitudes, od->n_bins * sizeof(float));
+
+	if (band_update(od, &od->full, full)) {
+		events |= ONSET_EVENT;
+		od->onsets++;
+	}
+	if (band_update(od, &od->low, low)) {
+		events |= BEAT_EVENT;
+		od->beats++;
+
+		/* Track the beat period with an exponential average of plausible
+		 * intervals. */
+		uint64_t interval = od->frames - od->last_beat_frame;
+		if (interval >= BEAT_PERIOD_MIN && interval <= BEAT_PERIOD_MAX)
+			od->beat_period = od->beat_period > 0
+				? 0.8f * od->beat_period + 0.2f * interval : interval;
+		else if (interval > BEAT_PERIOD_MAX)
+			od->beat_period = 0;
+		od->last_beat_frame = od->frames;
+	}
+
+	od->pos = (od->pos + 1) % ONSET_WINDOW;
+	if (od->filled < ONSET_WINDOW)
+		od->filled++;
+	od->frames++;
+	return events;
+}
+
+
+/** Estimated tempo for frames arriving at `frame_rate` Hz, 0 if unknown. */
+float onset_bpm(const OnsetDetector *od, float frame_rate) {
+	return od->beat_period > 0 ? 60.0f * frame_rate / od->beat_period : 0;
+}
+
+
+void onset_free(OnsetDetector *od) {
+	free(od->prev);
+	od->prev = NULL;
+}
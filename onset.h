@@ -0,0 +1,64 @@
+/** ONSET
+ *
+ * Incremental onset and beat detection on the magnitudes vmatrix already
+ * computes, so beat-reactive consumers do not need their own FFT.
+ *
+ * Each frame adds the positive spectral flux (the summed rise in
+ * magnitude since the previous frame) for the full band and for a low
+ * "beat" band to rolling windows. The full band is every bin vmatrix
+ * computes: up to Nyquist, or only up to the views and the beat band when
+ * the FFT is pruned (FFT_PRUNE). A frame is an onset (or beat) when its
+ * flux exceeds the window mean by `sensitivity` standard deviations,
+ * outside a short refractory period. The window statistics are kept as
+ * running sums, so a frame costs O(bins) whatever the window length.
+ */
+
+#ifndef ONSET_H
+#define ONSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ONSET_WINDOW 43      // frames in the adaptive threshold window
+#define ONSET_MIN_FRAMES 8   // frames needed before events are reported
+
+/* Event bits returned by `onset_update`. */
+#define ONSET_EVENT 0x1
+#define BEAT_EVENT 0x2
+
+
+/* Data structures. */
+typedef struct {
+	float flux[ONSET_WINDOW];  // ring of recent flux values
+	double sum;                // running sum of `flux`
+	double sum_sq;             // running sum of squares of `flux`
+	int since_event;           // frames since the last event
+} FluxBand;
+
+typedef struct {
+	int n_bins;
+	int beat_bins;         // bins [1, beat_bins) form the beat band
+	float sensitivity;     // threshold in standard deviations above the mean
+	int refractory;        // minimum frames between events of one kind
+	float *prev;           // magnitudes of the previous frame
+
+	FluxBand full;
+	FluxBand low;
+	int pos;               // next ring slot
+	int filled;            // ring slots in use
+
+	uint64_t frames;
+	uint64_t onsets;
+	uint64_t beats;
+	uint64_t last_beat_frame;
+	float beat_period;     // smoothed frames between beats, 0 if unknown
+} OnsetDetector;
+
+
+/* Function declarations. */
+bool onset_init(OnsetDetector *od, int n_bins, int beat_bins, float sensitivity, int refractory);
+uint32_t onset_update(OnsetDetector *od, const float *amplitudes);
+float onset_bpm(const OnsetDetector *od, float frame_rate);
+void onset_free(OnsetDetector *od);
+
+#endif
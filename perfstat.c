@@ -0,0 +1,154 @@
+/** PERFSTAT
+ *
+ * Per-stage perf event counting.
+ */
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "perfstat.h"
+#include "pipeline.h"
+
+const char *perf_stage_names[PERF_STAGES] = {
+	"capture", "fft", "binning", "render", "present"
+};
+
+static const uint64_t event_configs[PERF_EVENTS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+
+static int open_event(uint64_t config, int group_fd) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;   // allowed at the default perf_event_paranoid
+	attr.exclude_hv = 1;
+	attr.disabled = group_fd == -1;
+
+	/* This thread, on whichever CPU it runs. */
+	return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+
+/** Open the counters for the calling thread. Returns false, after saying
+ * why the first time, if no counter could be opened; stages are then
+ * only timed. */
+bool perf_counters_open(PerfCounters *pc) {
+	static bool warned;
+
+	memset(pc, 0, sizeof(PerfCounters));
+	pc->group_fd = -1;
+
+	for (int e = 0; e < PERF_EVENTS; ++e) {
+		int fd = open_event(event_configs[e], pc->group_fd);
+		if (fd < 0)
+			continue;
+		if (pc->group_fd == -1)
+			pc->group_fd = fd;
+		pc->fds[pc->n_events] = fd;
+		pc->event[pc->n_events++] = e;
+		pc->available[e] = true;
+	}
+
+	if (pc->group_fd == -1) {
+		if (!warned)
+			fprintf(stderr, "perf: no hardware counters (%s); timing stages only.\n",
+					strerror(errno));
+		warned = true;
+		return false;
+	}
+	ioctl(pc->group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(pc->group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+
+/** Close the counters. The stage totals are kept for `perf_report`. */
+void perf_counters_close(PerfCounters *pc) {
+	for (int i = pc->n_events - 1; i >= 0; --i)
+		close(pc->fds[i]);
+	pc->n_events = 0;
+	pc->group_fd = -1;
+}
+
+
+/** Read the group into `values`, indexed by PERF_* event. */
+static bool read_counters(const PerfCounters *pc, uint64_t *values) {
+	uint64_t buf[1 + PERF_EVENTS];
+
+	if (pc->group_fd < 0 || read(pc->group_fd, buf, sizeof(buf)) < (ssize_t) sizeof(uint64_t))
+		return false;
+	for (uint64_t i = 0; i < buf[0] && i < (uint64_t) pc->n_events; ++i)
+		values[pc->event[i]] = buf[1 + i];
+	return true;
+}
+
+
+void perf_stage_begin(PerfCounters *pc) {
+	read_counters(pc, pc->start);
+	pc->start_ns = monotonic_ns();
+}
+
+
+void perf_stage_end(PerfCounters *pc, PerfStage stage) {
+	PerfTotals *t = &pc->stages[stage];
+	uint64_t now[PERF_EVENTS];
+
+	t->ns += monotonic_ns() - pc->start_ns;
+	t->calls++;
+	if (read_counters(pc, now))
+		for (int e = 0; e < PERF_EVENTS; ++e)
+			if (pc->available[e])
+				t->count[e] += now[e] - pc->start[e];
+}
+
+
+/** Print the totals of every stage, summed over the `n` threads' counters
+ * in `pcs`, per call and per analysis frame. */
+void perf_report(const PerfCounters *pcs, int n, uint64_t frames) {
+	bool available[PERF_EVENTS] = {false};
+
+	for (int i = 0; i < n; ++i)
+		for (int e = 0; e < PERF_EVENTS; ++e)
+			available[e] |= pcs[i].available[e];
+
+	fprintf(stderr, "perf: %-8s %9s %9s %9s %6s %12s %13s\n", "stage", "calls",
+			"us/call", "kcyc/call", "IPC", "cache miss/f", "branch miss/f");
+	for (int s = 0; s < PERF_STAGES; ++s) {
+		PerfTotals t = {{0}, 0, 0};
+		for (int i = 0; i < n; ++i) {
+			for (int e = 0; e < PERF_EVENTS; ++e)
+				t.count[e] += pcs[i].stages[s].count[e];
+			t.ns += pcs[i].stages[s].ns;
+			t.calls += pcs[i].stages[s].calls;
+		}
+		if (t.calls == 0)
+			continue;
+
+		char cycles[16] = "-", ipc[16] = "-", cache[16] = "-", branch[16] = "-";
+		if (available[PERF_CYCLES])
+			snprintf(cycles, sizeof(cycles), "%.1f", t.count[PERF_CYCLES] / 1e3 / t.calls);
+		if (available[PERF_CYCLES] && available[PERF_INSTRUCTIONS] && t.count[PERF_CYCLES] > 0)
+			snprintf(ipc, sizeof(ipc), "%.2f",
+					(double) t.count[PERF_INSTRUCTIONS] / t.count[PERF_CYCLES]);
+		if (available[PERF_CACHE_MISSES] && frames > 0)
+			snprintf(cache, sizeof(cache), "%.0f", (double) t.count[PERF_CACHE_MISSES] / frames);
+		if (available[PERF_BRANCH_MISSES] && frames > 0)
+			snprintf(branch, sizeof(branch), "%.0f", (double) t.count[PERF_BRANCH_MISSES] / frames);
+
+		fprintf(stderr, "perf: %-8s %9llu %9.1f %9s %6s %12s %13s\n", perf_stage_names[s],
+				(unsigned long long) t.calls, t.ns / 1e3 / t.calls, cycles, ipc, cache, branch);
+	}
+}
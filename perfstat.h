@@ -0,0 +1,71 @@
+/** PERFSTAT
+ *
+ * Hardware performance counters per pipeline stage, for telling whether a
+ * stage is bound by cache misses, branch mispredictions or plain work.
+ *
+ * Each thread opens its own group of Linux perf events (cycles,
+ * instructions, cache misses and branch misses, user space only) and
+ * brackets its stages with `perf_stage_begin` / `perf_stage_end`; the
+ * counter deltas and wall time are added to that stage's totals. Events
+ * the CPU, kernel or container does not provide are left out, and with
+ * none at all only the wall time is kept, so the mode works on any Linux
+ * box.
+ */
+
+#ifndef PERFSTAT_H
+#define PERFSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Pipeline stages. */
+typedef enum {
+	STAGE_CAPTURE,
+	STAGE_FFT,
+	STAGE_BINNING,
+	STAGE_RENDER,
+	STAGE_PRESENT,
+	PERF_STAGES
+} PerfStage;
+
+/* Counted events. */
+enum {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_EVENTS
+};
+
+
+/* Data structures. */
+typedef struct {
+	uint64_t count[PERF_EVENTS];
+	uint64_t ns;
+	uint64_t calls;
+} PerfTotals;
+
+typedef struct {
+	int group_fd;              // -1 without counters
+	int n_events;              // events in the group, in `event` order
+	int fds[PERF_EVENTS];      // group members, the leader first
+	int event[PERF_EVENTS];    // PERF_* counted by each group member
+	bool available[PERF_EVENTS];
+	uint64_t start[PERF_EVENTS];
+	uint64_t start_ns;
+	PerfTotals stages[PERF_STAGES];
+} PerfCounters;
+
+
+extern const char *perf_stage_names[PERF_STAGES];
+
+
+/* Function declarations. */
+bool perf_counters_open(PerfCounters *pc);
+void perf_counters_close(PerfCounters *pc);
+void perf_stage_begin(PerfCounters *pc);
+void perf_stage_end(PerfCounters *pc, PerfStage stage);
+void perf_report(const PerfCounters *pcs, int n, uint64_t frames);
+
+#endif
@@ -0,0 +1,197 @@
+/** PIPELINE
+ *
+ * Block queue and latest-frame exchange between pipeline threads.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pipeline.h"
+
+
+/** Current CLOCK_MONOTONIC time in nanoseconds. */
+uint64_t monotonic_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+bool block_queue_init(BlockQueue *q, int capacity, int block_size) {
+	memset(q, 0, sizeof(BlockQueue));
+	q->capacity = capacity;
+	q->block_size = block_size;
+	q->data = calloc((size_t) capacity * block_size, sizeof(short));
+	q->timestamps = calloc(capacity, sizeof(uint64_t));
+	if (q->data == NULL || q->timestamps == NULL) {
+		free(q->data);
+		free(q->timestamps);
+		return false;
+	}
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+	return true;
+}
+
+
+void block_queue_destroy(BlockQueue *q) {
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->cond);
+	free(q->data);
+	free(q->timestamps);
+}
+
+
+/** Append a block, dropping the oldest unread one if the queue is full. */
+void block_queue_push(BlockQueue *q, const short *block, uint64_t timestamp_ns) {
+	pthread_mutex_lock(&q->lock);
+	if (q->head - q->tail == (uint64_t) q->capacity) {
+		q->tail++;
+		q->dropped++;
+	}
+	int slot = q->head % q->capacity;
+	memcpy(q->data + (size_t) slot * q->block_size, block, q->block_size * sizeof(short));
+	q->timestamps[slot] = timestamp_ns;
+	q->head++;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+
+/** Wait for the next block. Returns false once the queue is closed and
+ * drained. */
+bool block_queue_pop(BlockQueue *q, short *block, uint64_t *timestamp_ns) {
+	pthread_mutex_lock(&q->lock);
+	while (q->head == q->tail && !q->closed)
+		pthread_cond_wait(&q->cond, &q->lock);
+	if (q->head == q->tail) {
+		pthread_mutex_unlock(&q->lock);
+		return false;
+	}
+	int slot = q->tail % q->capacity;
+	memcpy(block, q->data + (size_t) slot * q->block_size, q->block_size * sizeof(short));
+	if (timestamp_ns)
+		*timestamp_ns = q->timestamps[slot];
+	q->tail++;
+	pthread_mutex_unlock(&q->lock);
+	return true;
+}
+
+
+void block_queue_close(BlockQueue *q) {
+	pthread_mutex_lock(&q->lock);
+	q->closed = true;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+
+bool frame_exchange_init(FrameExchange *fx, int size) {
+	memset(fx, 0, sizeof(FrameExchange));
+	fx->size = size;
+	if ((fx->bins = calloc(size, sizeof(float))) == NULL)
+		return false;
+	pthread_mutex_init(&fx->lock, NULL);
+	pthread_cond_init(&fx->cond, NULL);
+	return true;
+}
+
+
+void frame_exchange_destroy(FrameExchange *fx) {
+	pthread_mutex_destroy(&fx->lock);
+	pthread_cond_destroy(&fx->cond);
+	free(fx->bins);
+}
+
+
+/** Replace the latest frame. Events accumulate until the renderer takes
+ * them, so a skipped frame does not lose a beat. */
+void frame_exchange_put(FrameExchange *fx, const float *bins, uint32_t events, uint64_t timestamp_ns) {
+	pthread_mutex_lock(&fx->lock);
+	memcpy(fx->bins, bins, fx->size * sizeof(float));
+	fx->events |= events;
+	fx->timestamp_ns = timestamp_ns;
+	fx->seq++;
+	pthread_cond_broadcast(&fx->cond);
+	pthread_mutex_unlock(&fx->lock);
+}
+
+
+/** Wait until a frame newer than `*seq` is available and copy it out,
+ * updating `*seq`. Returns false once the exchange is closed. */
+bool frame_exchange_wait(FrameExchange *fx, float *bins, uint32_t *events, uint64_t *seq, uint64_t *timestamp_ns) {
+	pthread_mutex_lock(&fx->lock);
+	while (fx->seq == *seq && !fx->closed)
+		pthread_cond_wait(&fx->cond, &fx->lock);
+	if (fx->closed) {
+		pthread_mutex_unlock(&fx->lock);
+		return false;
+	}
+	memcpy(bins, fx->bins, fx->size * sizeof(float));
+	*events = fx->events;
+	fx->events = 0;
+	*seq = fx->seq;
+	if (timestamp_ns)
+		*timestamp_ns = fx->timestamp_ns;
+	pthread_mutex_unlock(&fx->lock);
+	return true;
+}
+
+
+/** Like `frame_exchange_wait`, but never blocks: copies the latest frame
+ * out only if it is newer than `*seq`. Returns false once the exchange is
+ * closed. */
+bool frame_exchange_poll(FrameExchange *fx, float *bins, uint32_t *events, uint64_t *seq, uint64_t *timestamp_ns) {
+	pthread_mutex_lock(&fx->lock);
+	if (fx->closed) {
+		pthread_mutex_unlock(&fx->lock);
+		return false;
+	}
+	if (fx->seq != *seq) {
+		memcpy(bins, fx->bins, fx->size * sizeof(float));
+		*events = fx->events;
+		fx->events = 0;
+		*seq = fx->seq;
+		if (timestamp_ns)
+			*timestamp_ns = fx->timestamp_ns;
+	}
+	pthread_mutex_unlock(&fx->lock);
+	return true;
+}
+
+
+void frame_exchange_close(FrameExchange *fx) {
+	pthread_mutex_lock(&fx->lock);
+	fx->closed = true;
+	pthread_cond_broadcast(&fx->cond);
+	pthread_mutex_unlock(&fx->lock);
+}
+
+
+/** Start with the nominal frame interval `period_ns`. */
+void render_clock_init(RenderClock *rc, float period_ns) {
+	rc->frame_ns = 0;
+	rc->period_ns = period_ns;
+}
+
+
+/** Note a new frame captured at `timestamp_ns`. The interval estimate is
+ * smoothed so that jitter in the capture wake-ups does not show. */
+void render_clock_frame(RenderClock *rc, uint64_t timestamp_ns) {
+	if (rc->frame_ns != 0 && timestamp_ns > rc->frame_ns) {
+		float interval = timestamp_ns - rc->frame_ns;
+		if (interval < 4 * rc->period_ns)
+			rc->period_ns += 0.05f * (interval - rc->period_ns);
+	}
+	rc->frame_ns = timestamp_ns;
+}
+
+
+/** Fraction of a frame interval elapsed since the latest frame at
+ * `now_ns`, clamped to [0, 1]. */
+float render_clock_phase(const RenderClock *rc, uint64_t now_ns) {
+	if (rc->frame_ns == 0 || now_ns <= rc->frame_ns)
+		return 0;
+	float phase = (now_ns - rc->frame_ns) / rc->period_ns;
+	return phase < 1 ? phase : 1;
+}
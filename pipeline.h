@@ -0,0 +1,77 @@
+/** PIPELINE
+ *
+ * Hand-off points between the capture, analysis and render stages when
+ * they run on separate threads.
+ *
+ * `BlockQueue` carries raw sample blocks from capture to analysis. It is a
+ * small ring; when analysis falls behind, the oldest block is dropped and
+ * counted rather than stalling the sound card.
+ *
+ * `FrameExchange` holds only the latest analysis result. The renderer
+ * always draws the newest frame and never queues up stale ones.
+ *
+ * `RenderClock` lets the renderer run faster than analysis: it tracks the
+ * capture timestamps of arriving frames and says how far the display
+ * time has moved from the latest frame towards the next one.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Data structures. */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int capacity;           // blocks
+	int block_size;         // samples per block
+	short *data;
+	uint64_t *timestamps;   // CLOCK_MONOTONIC ns when each block was read
+	uint64_t head;          // next block to write
+	uint64_t tail;          // next block to read
+	uint64_t dropped;       // blocks overwritten before being read
+	bool closed;
+} BlockQueue;
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int size;               // floats per frame
+	float *bins;
+	uint64_t seq;           // frames put so far
+	uint64_t timestamp_ns;  // capture time of the latest frame
+	uint32_t events;        // analysis events not yet taken by the renderer
+	bool closed;
+} FrameExchange;
+
+typedef struct {
+	uint64_t frame_ns;      // capture time of the latest frame
+	float period_ns;        // smoothed interval between frames
+} RenderClock;
+
+
+/* Function declarations. */
+uint64_t monotonic_ns();
+
+bool block_queue_init(BlockQueue *q, int capacity, int block_size);
+void block_queue_destroy(BlockQueue *q);
+void block_queue_push(BlockQueue *q, const short *block, uint64_t timestamp_ns);
+bool block_queue_pop(BlockQueue *q, short *block, uint64_t *timestamp_ns);
+void block_queue_close(BlockQueue *q);
+
+bool frame_exchange_init(FrameExchange *fx, int size);
+void frame_exchange_destroy(FrameExchange *fx);
+void frame_exchange_put(FrameExchange *fx, const float *bins, uint32_t events, uint64_t timestamp_ns);
+bool frame_exchange_wait(FrameExchange *fx, float *bins, uint32_t *events, uint64_t *seq, uint64_t *timestamp_ns);
+bool frame_exchange_poll(FrameExchange *fx, float *bins, uint32_t *events, uint64_t *seq, uint64_t *timestamp_ns);
+void frame_exchange_close(FrameExchange *fx);
+
+void render_clock_init(RenderClock *rc, float period_ns);
+void render_clock_frame(RenderClock *rc, uint64_t timestamp_ns);
+float render_clock_phase(const RenderClock *rc, uint64_t now_ns);
+
+#endif
@@ -0,0 +1,86 @@
+/** RT
+ *
+ * Scheduling, affinity and memory-locking helpers.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "rt.h"
+
+
+/** Lock current and future pages in RAM so that the loop never takes a
+ * major page fault. */
+bool rt_lock_memory() {
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+		fprintf(stderr, "rt: cannot lock memory (%s)%s\n", strerror(errno),
+				errno == EPERM || errno == ENOMEM
+				? "; needs root, CAP_IPC_LOCK or a higher RLIMIT_MEMLOCK" : "");
+		return false;
+	}
+	return true;
+}
+
+
+/** Name the calling thread, give it SCHED_FIFO `priority` (0 keeps the
+ * default policy) and pin it to `cpu` (-1 leaves affinity alone). */
+bool rt_configure_thread(const char *name, int priority, int cpu) {
+	pthread_t self = pthread_self();
+	bool ok = true;
+	int err;
+
+	pthread_setname_np(self, name);
+
+	if (priority > 0) {
+		struct sched_param param = { .sched_priority = priority };
+		if ((err = pthread_setschedparam(self, SCHED_FIFO, &param)) != 0) {
+			fprintf(stderr, "rt: %s: cannot set SCHED_FIFO priority %d (%s)%s\n",
+					name, priority, strerror(err),
+					err == EPERM ? "; needs root, CAP_SYS_NICE or RLIMIT_RTPRIO" : "");
+			ok = false;
+		}
+	}
+
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if ((err = pthread_setaffinity_np(self, sizeof(set), &set)) != 0) {
+			fprintf(stderr, "rt: %s: cannot pin to CPU %d (%s)\n",
+					name, cpu, strerror(err));
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+
+/** Touch every page of `ptr` so it is backed before the loop starts.
+ * Contents are preserved. */
+void rt_prefault(void *ptr, size_t len) {
+	volatile unsigned char *p = ptr;
+	long page = sysconf(_SC_PAGESIZE);
+
+	if (ptr == NULL || len == 0)
+		return;
+	for (size_t i = 0; i < len; i += page)
+		p[i] = p[i];
+	p[len - 1] = p[len - 1];
+}
+
+
+/** Grow the calling thread's stack by RT_STACK_PREFAULT bytes now, so later
+ * deep calls (the FFT buffers live on the stack) do not fault. */
+void rt_prefault_stack() {
+	volatile unsigned char stack[RT_STACK_PREFAULT];
+	long page = sysconf(_SC_PAGESIZE);
+
+	for (size_t i = 0; i < sizeof(stack); i += page)
+		stack[i] = 0;
+}
@@ -0,0 +1,26 @@
+/** RT
+ *
+ * Opt-in real-time runtime profile: SCHED_FIFO priorities and CPU affinity
+ * per pipeline thread, locked memory and prefaulted buffers and stack.
+ *
+ * Every call reports what it could not do (usually missing CAP_SYS_NICE or
+ * CAP_IPC_LOCK, or an RLIMIT that is too low) and carries on, so the
+ * profile degrades to normal scheduling instead of refusing to start.
+ */
+
+#ifndef RT_H
+#define RT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RT_STACK_PREFAULT (256 * 1024)  // bytes of stack touched per thread
+
+
+/* Function declarations. */
+bool rt_lock_memory();
+bool rt_configure_thread(const char *name, int priority, int cpu);
+void rt_prefault(void *ptr, size_t len);
+void rt_prefault_stack();
+
+#endif
@@ -0,0 +1,257 @@
+/** SIGNALS
+ *
+ * Block generators for the deterministic test signals.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "signals.h"
+
+
+/* Sine table with one guard entry for interpolation. */
+static float sine_table[SINE_TABLE_SIZE + 1];
+static int sine_table_ready = 0;
+
+#define PHASE_FRAC_BITS (32 - SINE_TABLE_BITS)
+#define PHASE_FRAC_MASK ((1u << PHASE_FRAC_BITS) - 1)
+
+typedef float v4sf __attribute__((vector_size(4 * SIGNAL_LANES)));
+typedef uint32_t v4su __attribute__((vector_size(4 * SIGNAL_LANES)));
+typedef uint64_t v4du __attribute__((vector_size(8 * SIGNAL_LANES)));
+
+
+/** Fill the sine table. Safe to call more than once. */
+void sine_table_init() {
+	if (sine_table_ready)
+		return;
+	for (int i = 0; i <= SINE_TABLE_SIZE; ++i)
+		sine_table[i] = (float) sin(2.0 * M_PI * i / SINE_TABLE_SIZE);
+	sine_table_ready = 1;
+}
+
+
+/** Look up sin(2*pi*phase/2^32), interpolating between table entries. */
+static inline float sine_lookup(uint32_t phase) {
+	uint32_t idx = phase >> PHASE_FRAC_BITS;
+	float frac = (float) (phase & PHASE_FRAC_MASK) * (1.0f / (1u << PHASE_FRAC_BITS));
+	float a = sine_table[idx];
+	return a + (sine_table[idx + 1] - a) * frac;
+}
+
+
+/** Set an oscillator to `freq` Hz at sampling rate `rate`. */
+void oscillator_init(Oscillator *osc, double freq, double rate, float amplitude) {
+	osc->phase = 0;
+	osc->step = (uint32_t) (freq / rate * 4294967296.0);
+	osc->amplitude = amplitude;
+}
+
+
+/** Look up the sines of four phases at once. The index and interpolation
+ * arithmetic is vectorized; the table reads are per lane. */
+static inline v4sf sine_lookup4(v4su phase) {
+	v4su idx = phase >> PHASE_FRAC_BITS;
+	v4sf frac = __builtin_convertvector(phase & PHASE_FRAC_MASK, v4sf) *
+			(1.0f / (1u << PHASE_FRAC_BITS));
+	v4sf a, b;
+	for (int l = 0; l < SIGNAL_LANES; ++l) {
+		a[l] = sine_table[idx[l]];
+		b[l] = sine_table[idx[l] + 1];
+	}
+	return a + (b - a) * frac;
+}
+
+
+/** Add `n` samples of `osc` to `out`, `SIGNAL_LANES` at a time. Lane `l`
+ * carries the phase of every sample `l` modulo SIGNAL_LANES. */
+static void oscillator_accumulate(Oscillator *osc, float *out, int n) {
+	v4su lanes = {0, 1, 2, 3};
+	v4su phase = osc->phase + lanes * osc->step;
+	uint32_t step = SIGNAL_LANES * osc->step;
+	int i = 0;
+
+	for (; i + SIGNAL_LANES <= n; i += SIGNAL_LANES) {
+		v4sf o;
+		memcpy(&o, out + i, sizeof(o));
+		o += osc->amplitude * sine_lookup4(phase);
+		memcpy(out + i, &o, sizeof(o));
+		phase += step;
+	}
+
+	uint32_t tail = phase[0];
+	for (; i < n; ++i) {
+		out[i] += osc->amplitude * sine_lookup(tail);
+		tail += osc->step;
+	}
+	osc->phase = tail;
+}
+
+
+/** Step the xorshift64* generators of all lanes; returns one float per
+ * lane, uniformly in [-1, 1). */
+static inline v4sf rng_next4(uint64_t *state) {
+	v4du x;
+	memcpy(&x, state, sizeof(x));
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	memcpy(state, &x, sizeof(x));
+	v4du r = (x * 0x2545f4914f6cdd1dull) >> 40;  // 24 bits
+	return __builtin_convertvector(r, v4sf) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+
+/** Fill `out` with `n` samples of white noise, interleaved from the lanes.
+ * Samples left over from a partial step are kept for the next call. */
+static void noise_fill(Signal *s, float *out, int n) {
+	int i = 0;
+
+	while (i < n && s->noise_used < SIGNAL_LANES)
+		out[i++] = s->noise[s->noise_used++];
+	for (; i + SIGNAL_LANES <= n; i += SIGNAL_LANES) {
+		v4sf w = rng_next4(s->rng);
+		memcpy(out + i, &w, sizeof(w));
+	}
+	if (i < n) {
+		v4sf w = rng_next4(s->rng);
+		memcpy(s->noise, &w, sizeof(w));
+		s->noise_used = 0;
+		while (i < n)
+			out[i++] = s->noise[s->noise_used++];
+	}
+}
+
+
+/** splitmix64, for deriving the lane seeds from one seed. */
+static uint64_t splitmix64(uint64_t *x) {
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+
+/** Initialize `s` with the defaults for `type`. Tones and burst start with
+ * no tone configured and get 1 kHz if none is added before filling. */
+void signal_init(Signal *s, SignalType type, double rate, uint64_t seed) {
+	memset(s, 0, sizeof(Signal));
+	sine_table_init();
+
+	s->type = type;
+	s->rate = rate;
+	/* Independent, nonzero lane states. */
+	uint64_t x = seed ? seed : SIGNAL_DEFAULT_SEED;
+	for (int l = 0; l < SIGNAL_LANES; ++l)
+		while ((s->rng[l] = splitmix64(&x)) == 0)
+			;
+	s->noise_used = SIGNAL_LANES;
+
+	signal_set_sweep(s, 20.0, rate / 2.0 * 0.9, 5.0);
+	signal_set_period(s, 0.5, 0.05);
+}
+
+
+/** Add a tone to a SIGNAL_TONES or SIGNAL_BURST signal. Tones share the
+ * full-scale range equally. */
+void signal_add_tone(Signal *s, double freq) {
+	if (s->n_tones >= SIGNAL_MAX_TONES)
+		return;
+	oscillator_init(&s->tones[s->n_tones++], freq, s->rate, 1.0f);
+	for (int i = 0; i < s->n_tones; ++i)
+		s->tones[i].amplitude = 1.0f / s->n_tones;
+}
+
+
+/** Sweep logarithmically from `f0` to `f1` Hz over `seconds`, then restart. */
+void signal_set_sweep(Signal *s, double f0, double f1, double seconds) {
+	s->sweep_f0 = f0;
+	s->sweep_f1 = f1;
+	s->sweep_len = (long) (seconds * s->rate);
+	if (s->sweep_len < 1)
+		s->sweep_len = 1;
+	s->sweep_ratio = pow(f1 / f0, 1.0 / s->sweep_len);
+	s->sweep_step = f0 / s->rate * 4294967296.0;
+	s->sweep_phase = 0;
+}
+
+
+/** Set the impulse / burst period and how long each burst lasts. */
+void signal_set_period(Signal *s, double period_seconds, double on_seconds) {
+	s->period = (long) (period_seconds * s->rate);
+	if (s->period < 1)
+		s->period = 1;
+	s->burst_len = (long) (on_seconds * s->rate);
+}
+
+
+/** Generate the next `n` samples of `s` into `out`. */
+void signal_fill(Signal *s, float *out, int n) {
+	if ((s->type == SIGNAL_TONES || s->type == SIGNAL_BURST) && s->n_tones == 0)
+		signal_add_tone(s, 1000.0);
+
+	switch (s->type) {
+		case SIGNAL_TONES:
+			memset(out, 0, n * sizeof(float));
+			for (int k = 0; k < s->n_tones; ++k)
+				oscillator_accumulate(&s->tones[k], out, n);
+			break;
+
+		case SIGNAL_SWEEP:
+			for (int i = 0; i < n; ++i) {
+				if ((s->t + i) % s->sweep_len == 0)
+					s->sweep_step = s->sweep_f0 / s->rate * 4294967296.0;
+				out[i] = sine_lookup(s->sweep_phase);
+				s->sweep_phase += (uint32_t) s->sweep_step;
+				s->sweep_step *= s->sweep_ratio;
+			}
+			break;
+
+		case SIGNAL_WHITE:
+			noise_fill(s, out, n);
+			break;
+
+		case SIGNAL_PINK:
+			/* Paul Kellet's economy pink filter: three one-pole
+			 * sections approximate -3 dB/octave within 0.5 dB. The
+			 * white noise is generated first, in place. */
+			noise_fill(s, out, n);
+			for (int i = 0; i < n; ++i) {
+				float w = out[i];
+				s->pink[0] = 0.99765f * s->pink[0] + w * 0.0990460f;
+				s->pink[1] = 0.96300f * s->pink[1] + w * 0.2965164f;
+				s->pink[2] = 0.57000f * s->pink[2] + w * 1.0526913f;
+				out[i] = 0.11f * (s->pink[0] + s->pink[1] + s->pink[2] + w * 0.1848f);
+			}
+			break;
+
+		case SIGNAL_IMPULSE:
+			memset(out, 0, n * sizeof(float));
+			for (int i = 0; i < n; ++i)
+				if ((s->t + i) % s->period == 0)
+					out[i] = 1.0f;
+			break;
+
+		case SIGNAL_BURST:
+			memset(out, 0, n * sizeof(float));
+			for (int k = 0; k < s->n_tones; ++k)
+				oscillator_accumulate(&s->tones[k], out, n);
+			for (int i = 0; i < n; ++i)
+				if ((s->t + i) % s->period >= s->burst_len)
+					out[i] = 0.0f;
+			break;
+	}
+
+	s->t += n;
+}
+
+
+/** Map a signal name to its `SignalType`, or -1 if unknown. */
+int signal_type_from_name(const char *name) {
+	static const char *names[] = {
+		"tones", "sweep", "white", "pink", "impulse", "burst"
+	};
+	for (int i = 0; i < (int) (sizeof(names) / sizeof(names[0])); ++i)
+		if (strcmp(name, names[i]) == 0)
+			return i;
+	return -1;
+}
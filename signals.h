@@ -0,0 +1,84 @@
+/** SIGNALS
+ *
+ * Deterministic test signals for load and accuracy runs: sums of tones,
+ * logarithmic sweeps, white and pink noise, impulse trains and tone bursts.
+ *
+ * Signals are generated a block at a time into float buffers in [-1, 1].
+ * Every random source is seeded explicitly, so a given type, rate and seed
+ * always produces the same samples, however the output is split into
+ * blocks.
+ *
+ * Tones and noise are generated `SIGNAL_LANES` samples at a time: the
+ * oscillator phase is linear in time, so each lane starts one step apart
+ * and advances by `SIGNAL_LANES` steps, and noise comes from that many
+ * independent generators whose outputs are interleaved. The sweep and
+ * the pink noise filter are recursive from sample to sample and stay
+ * scalar; pink noise still draws its white noise from the lanes.
+ */
+
+#ifndef SIGNALS_H
+#define SIGNALS_H
+
+#include <stdint.h>
+
+#define SIGNAL_MAX_TONES 8
+#define SIGNAL_DEFAULT_SEED 0x9e3779b97f4a7c15ull
+#define SINE_TABLE_BITS 12  // sine table has 2^SINE_TABLE_BITS entries
+#define SINE_TABLE_SIZE (1 << SINE_TABLE_BITS)
+#define SIGNAL_LANES 4      // samples generated per vector step
+
+
+/* Signal types. */
+typedef enum {
+	SIGNAL_TONES,    // sum of up to SIGNAL_MAX_TONES sinusoids
+	SIGNAL_SWEEP,    // repeating logarithmic sweep
+	SIGNAL_WHITE,    // uniform white noise
+	SIGNAL_PINK,     // -3 dB/octave noise
+	SIGNAL_IMPULSE,  // one full-scale sample per period
+	SIGNAL_BURST     // tone switched on for part of every period
+} SignalType;
+
+
+/* Data structures. */
+typedef struct {
+	uint32_t phase;  // current phase, full turn = 2^32
+	uint32_t step;   // phase increment per sample
+	float amplitude;
+} Oscillator;
+
+typedef struct {
+	SignalType type;
+	double rate;           // Hz
+	long long t;           // samples generated so far
+
+	int n_tones;
+	Oscillator tones[SIGNAL_MAX_TONES];
+
+	double sweep_f0;       // Hz, sweep start
+	double sweep_f1;       // Hz, sweep end
+	long sweep_len;        // samples per sweep
+	double sweep_ratio;    // per-sample frequency multiplier
+	double sweep_step;     // current phase step
+	uint32_t sweep_phase;
+
+	long period;           // samples between impulses / burst starts
+	long burst_len;        // samples the burst tone is on
+
+	uint64_t rng[SIGNAL_LANES];    // xorshift64* state per lane
+	float noise[SIGNAL_LANES];     // white noise generated but not yet used
+	int noise_used;                // samples of `noise` already used
+	float pink[3];         // pink noise filter state
+} Signal;
+
+
+/* Function declarations. */
+void sine_table_init();
+void oscillator_init(Oscillator *osc, double freq, double rate, float amplitude);
+void signal_init(Signal *s, SignalType type, double rate, uint64_t seed);
+void signal_add_tone(Signal *s, double freq);
+void signal_set_sweep(Signal *s, double f0, double f1, double seconds);
+void signal_set_period(Signal *s, double period_seconds, double on_seconds);
+void signal_fill(Signal *s, float *out, int n);
+int signal_type_from_name(const char *name);
+
+#endif
@@ -0,0 +1,203 @@
+/** SPECTRUM_SHM
+ *
+ * Writer and reader sides of the shared-memory spectrum ring.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "spectrum_shm.h"
+
+
+/** Return the slot holding `frame`. */
+static SpectrumShmSlot *slot_for(SpectrumShm *shm, uint64_t frame) {
+	SpectrumShmHeader *h = shm->header;
+	return (SpectrumShmSlot *) (shm->slots + (frame % h->n_slots) * h->slot_size);
+}
+
+
+/** Map `size` bytes of the shared-memory object `fd` into `shm`. */
+static bool map_segment(SpectrumShm *shm, int fd, size_t size, int prot) {
+	void *addr = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return false;
+	}
+	shm->size = size;
+	shm->header = addr;
+	shm->slots = (unsigned char *) addr + sizeof(SpectrumShmHeader);
+	return true;
+}
+
+
+/** Create (or replace) the segment `name` and become its only writer. */
+SpectrumShm *spectrum_shm_create(const char *name, int n_bins, int n_slots, int sample_rate, int fft_size) {
+	SpectrumShm *shm;
+	int fd;
+
+	if (n_bins <= 0 || n_slots <= 0) {
+		fprintf(stderr, "spectrum_shm: bins and slots must be greater than 0.\n");
+		return NULL;
+	}
+
+	if ((shm = calloc(1, sizeof(SpectrumShm))) == NULL) {
+		fprintf(stderr, "spectrum_shm: error allocating handle.\n");
+		return NULL;
+	}
+	snprintf(shm->name, sizeof(shm->name), "%s", name);
+	shm->owner = true;
+
+	/* Round every slot up to a cache line so that readers of one slot do
+	 * not share lines with the slot being written. */
+	size_t slot_size = sizeof(SpectrumShmSlot) + n_bins * sizeof(float);
+	slot_size = (slot_size + 63) & ~(size_t) 63;
+	size_t size = sizeof(SpectrumShmHeader) + slot_size * n_slots;
+
+	shm_unlink(name);
+	if ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644)) < 0) {
+		perror("shm_open");
+		free(shm);
+		return NULL;
+	}
+	if (ftruncate(fd, size) < 0) {
+		perror("ftruncate");
+		close(fd);
+		shm_unlink(name);
+		free(shm);
+		return NULL;
+	}
+	if (!map_segment(shm, fd, size, PROT_READ | PROT_WRITE)) {
+		shm_unlink(name);
+		free(shm);
+		return NULL;
+	}
+
+	SpectrumShmHeader *h = shm->header;
+	h->version = SPECTRUM_SHM_VERSION;
+	h->n_bins = n_bins;
+	h->n_slots = n_slots;
+	h->slot_size = slot_size;
+	h->sample_rate = sample_rate;
+	h->fft_size = fft_size;
+	atomic_store_explicit(&h->frames_written, 0, memory_order_relaxed);
+
+	/* Write the magic last; readers refuse segments without it. */
+	atomic_thread_fence(memory_order_release);
+	h->magic = SPECTRUM_SHM_MAGIC;
+
+	return shm;
+}
+
+
+/** Map an existing segment read-only. */
+SpectrumShm *spectrum_shm_open(const char *name) {
+	SpectrumShm *shm;
+	struct stat st;
+	int fd;
+
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+		perror("shm_open");
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(SpectrumShmHeader)) {
+		fprintf(stderr, "spectrum_shm: segment %s is too small.\n", name);
+		close(fd);
+		return NULL;
+	}
+	if ((shm = calloc(1, sizeof(SpectrumShm))) == NULL) {
+		fprintf(stderr, "spectrum_shm: error allocating handle.\n");
+		close(fd);
+		return NULL;
+	}
+	snprintf(shm->name, sizeof(shm->name), "%s", name);
+	if (!map_segment(shm, fd, st.st_size, PROT_READ)) {
+		free(shm);
+		return NULL;
+	}
+
+	SpectrumShmHeader *h = shm->header;
+	if (h->magic != SPECTRUM_SHM_MAGIC || h->version != SPECTRUM_SHM_VERSION ||
+			sizeof(SpectrumShmHeader) + (size_t) h->slot_size * h->n_slots > shm->size) {
+		fprintf(stderr, "spectrum_shm: segment %s has an unknown layout.\n", name);
+		spectrum_shm_close(shm);
+		return NULL;
+	}
+	return shm;
+}
+
+
+/** Unmap the segment. The writer also removes its name. */
+void spectrum_shm_close(SpectrumShm *shm) {
+	if (shm == NULL)
+		return;
+	munmap(shm->header, shm->size);
+	if (shm->owner)
+		shm_unlink(shm->name);
+	free(shm);
+}
+
+
+/** Start a new frame and return its bins so the caller can fill them in
+ * place. The frame becomes visible to readers on `spectrum_shm_commit`. */
+float *spectrum_shm_begin(SpectrumShm *shm) {
+	SpectrumShmSlot *slot = slot_for(shm, shm->next_frame);
+	uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+	atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->frame = shm->next_frame;
+	return slot->bins;
+}
+
+
+/** Finish the frame started by `spectrum_shm_begin`, tagging it with the
+ * analysis `events` detected in it. */
+void spectrum_shm_commit(SpectrumShm *shm, uint32_t events) {
+	SpectrumShmSlot *slot = slot_for(shm, shm->next_frame);
+	struct timespec ts;
+
+	slot->events = events;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	slot->timestamp_ns = (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+	uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+	atomic_store_explicit(&slot->seq, seq + 1, memory_order_release);
+
+	shm->next_frame++;
+	atomic_store_explicit(&shm->header->frames_written, shm->next_frame,
+			memory_order_release);
+}
+
+
+/** Number of frames committed so far; the newest is this value minus 1. */
+uint64_t spectrum_shm_latest(SpectrumShm *shm) {
+	return atomic_load_explicit(&shm->header->frames_written, memory_order_acquire);
+}
+
+
+/** Copy `frame` into `out` (`n_bins` floats). Returns false if the frame
+ * has not been written yet, was already overwritten, or was torn by the
+ * writer during the copy; readers normally just retry with the latest. */
+bool spectrum_shm_read(SpectrumShm *shm, uint64_t frame, float *out, uint64_t *timestamp_ns, uint32_t *events) {
+	SpectrumShmHeader *h = shm->header;
+	SpectrumShmSlot *slot = slot_for(shm, frame);
+
+	uint32_t before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+	if ((before & 1) || slot->frame != frame)
+		return false;
+
+	memcpy(out, slot->bins, h->n_bins * sizeof(float));
+	if (timestamp_ns)
+		*timestamp_ns = slot->timestamp_ns;
+	if (events)
+		*events = slot->events;
+
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&slot->seq, memory_order_relaxed) == before;
+}
@@ -0,0 +1,65 @@
+/** SPECTRUM_SHM
+ *
+ * Publish spectrum frames into a POSIX shared-memory ring so that other
+ * local processes can read them without opening the sound card or
+ * repeating the FFT.
+ *
+ * The segment starts with a `SpectrumShmHeader` followed by `n_slots`
+ * fixed-size slots. Every slot carries its own sequence counter which is
+ * odd while the writer is filling it (a seqlock), so readers never block
+ * the writer and simply retry when they observe a torn frame.
+ */
+
+#ifndef SPECTRUM_SHM_H
+#define SPECTRUM_SHM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPECTRUM_SHM_MAGIC 0x564d5350  // "VMSP"
+#define SPECTRUM_SHM_VERSION 2
+
+
+/* Data structures. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t n_bins;        // floats per frame
+	uint32_t n_slots;       // frames kept in the ring
+	uint32_t slot_size;     // bytes per slot, including `SpectrumShmSlot`
+	uint32_t sample_rate;   // Hz
+	uint32_t fft_size;      // samples per FFT
+	uint32_t reserved;
+	_Atomic uint64_t frames_written;  // total frames committed
+} SpectrumShmHeader;
+
+typedef struct {
+	_Atomic uint32_t seq;   // odd while being written
+	uint32_t events;        // ONSET_EVENT / BEAT_EVENT bits (see onset.h)
+	uint64_t frame;         // frame number held in this slot
+	uint64_t timestamp_ns;  // CLOCK_MONOTONIC time of the commit
+	float bins[];
+} SpectrumShmSlot;
+
+typedef struct {
+	char name[64];
+	bool owner;             // true for the writer, which unlinks on close
+	size_t size;
+	SpectrumShmHeader *header;
+	unsigned char *slots;
+	uint64_t next_frame;    // writer: frame number being filled
+} SpectrumShm;
+
+
+/* Function declarations. */
+SpectrumShm *spectrum_shm_create(const char *name, int n_bins, int n_slots, int sample_rate, int fft_size);
+SpectrumShm *spectrum_shm_open(const char *name);
+void spectrum_shm_close(SpectrumShm *shm);
+float *spectrum_shm_begin(SpectrumShm *shm);
+void spectrum_shm_commit(SpectrumShm *shm, uint32_t events);
+uint64_t spectrum_shm_latest(SpectrumShm *shm);
+bool spectrum_shm_read(SpectrumShm *shm, uint64_t frame, float *out, uint64_t *timestamp_ns, uint32_t *events);
+
+#endif
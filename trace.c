@@ -0,0 +1,228 @@
+/** TRACE
+ *
+ * Per-thread event rings and the Chrome trace JSON dumper.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+
+_Thread_local TraceRing *trace_ring;
+
+static const char *mark_names[TRACE_MARKS] = {
+	"xrun", "dropped", "idle", "deadline", "dump"
+};
+
+static _Atomic(TraceRing *) rings[TRACE_THREADS];
+static atomic_int n_rings;
+static char trace_path[256];
+static uint64_t window_ns;
+static int dumps;
+static TraceEvent *scratch;        // copy of one ring, taken under `dump_lock`
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static sem_t requests;
+static atomic_bool forced;
+static atomic_bool stopping;
+static pthread_t dumper;
+static bool started;
+
+
+/** Copy the events of `r` recorded since `from_ns` into `scratch`, oldest
+ * first, and return how many there are. */
+static int snapshot(TraceRing *r, uint64_t from_ns) {
+	uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+	uint64_t first = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+
+	for (uint64_t i = first; i < head; ++i)
+		scratch[i - first] = r->events[i & (TRACE_EVENTS - 1)];
+
+	/* The writer claims a slot before it overwrites it, so any store to a
+	 * copied entry seen here comes with its claim. Event i may be torn if
+	 * its slot has been claimed again, by event i + TRACE_EVENTS; drop
+	 * those. */
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t claimed = atomic_load_explicit(&r->claimed, memory_order_relaxed);
+	uint64_t skip = claimed > TRACE_EVENTS + first ? claimed - TRACE_EVENTS - first : 0;
+	if (skip > head - first)
+		skip = head - first;
+
+	int n = 0;
+	for (uint64_t i = skip; i < head - first; ++i)
+		if (scratch[i].ns >= from_ns)
+			scratch[n++] = scratch[i];
+	return n;
+}
+
+
+/** Write one event of thread `tid` as a JSON object. */
+static void write_event(FILE *f, const TraceEvent *e, int pid, int tid, uint64_t from_ns) {
+	double ts = (e->ns - from_ns) / 1e3;
+
+	if (e->phase == 'i') {
+		fprintf(f, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+				"\"pid\":%d,\"tid\":%d,\"args\":{\"value\":%u}}",
+				e->name < TRACE_MARKS ? mark_names[e->name] : "?", ts, pid, tid, e->arg);
+	} else {
+		fprintf(f, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+				e->name < PERF_STAGES ? perf_stage_names[e->name] : "?", e->phase,
+				ts, pid, tid);
+	}
+}
+
+
+/** Background thread: dump on every request, except for requests that
+ * are not forced and arrive within a window of the previous dump. Its own
+ * ring records the dump marks. */
+static void *dumper_main(void *arg) {
+	uint64_t last_ns = 0;
+
+	trace_thread("vm-trace");
+	for (;;) {
+		while (sem_wait(&requests) != 0 && errno == EINTR)
+			;
+		if (atomic_load(&stopping))
+			break;
+		bool always = atomic_exchange(&forced, false);
+		uint64_t now_ns = monotonic_ns();
+		if (!always && last_ns != 0 && now_ns - last_ns < window_ns)
+			continue;
+		trace_dump();
+		last_ns = monotonic_ns();
+	}
+	return NULL;
+}
+
+
+/** Start the dumper. Dumps go to `path`-<n>.json and cover the last
+ * `seconds` before the request. */
+bool trace_init(const char *path, float seconds) {
+	snprintf(trace_path, sizeof(trace_path), "%s", path);
+	window_ns = seconds * 1e9;
+
+	if ((scratch = malloc(TRACE_EVENTS * sizeof(TraceEvent))) == NULL) {
+		fprintf(stderr, "trace: out of memory.\n");
+		return false;
+	}
+	started = true;
+	if (sem_init(&requests, 0, 0) != 0 ||
+			pthread_create(&dumper, NULL, dumper_main, NULL) != 0) {
+		perror("trace");
+		free(scratch);
+		scratch = NULL;
+		started = false;
+		return false;
+	}
+	return true;
+}
+
+
+/** Stop the dumper and free the rings. Every other recording thread must
+ * have exited. */
+void trace_shutdown() {
+	if (!started)
+		return;
+	atomic_store(&stopping, true);
+	sem_post(&requests);
+	pthread_join(dumper, NULL);
+	sem_destroy(&requests);
+
+	for (int i = 0; i < TRACE_THREADS; ++i)
+		free(atomic_exchange(&rings[i], NULL));
+	trace_ring = NULL;
+	free(scratch);
+	scratch = NULL;
+	started = false;
+}
+
+
+/** Give the calling thread a ring named `name`. Its pages are touched
+ * here, so recording never faults. */
+bool trace_thread(const char *name) {
+	TraceRing *r;
+
+	if (!started)
+		return false;
+	int i = atomic_fetch_add(&n_rings, 1);
+	if (i >= TRACE_THREADS) {
+		fprintf(stderr, "trace: more than %d threads, not tracing %s.\n",
+				TRACE_THREADS, name);
+		return false;
+	}
+	if ((r = malloc(sizeof(TraceRing))) == NULL) {
+		fprintf(stderr, "trace: out of memory.\n");
+		return false;
+	}
+	memset(r, 0, sizeof(TraceRing));
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->tid = i + 1;
+	atomic_store_explicit(&rings[i], r, memory_order_release);
+	trace_ring = r;
+	return true;
+}
+
+
+/** Ask the dumper to write a trace. Safe to call from a signal handler. */
+void trace_request_dump(bool always) {
+	if (!started)
+		return;
+	if (always)
+		atomic_store(&forced, true);
+	sem_post(&requests);
+}
+
+
+/** Write the last window of every ring now, on the calling thread. */
+bool trace_dump() {
+	char path[300];
+	int pid = getpid(), written = 0;
+	FILE *f;
+
+	if (!started)
+		return false;
+	trace_mark(MARK_DUMP, 0);
+
+	pthread_mutex_lock(&dump_lock);
+	uint64_t now_ns = monotonic_ns();
+	uint64_t from_ns = now_ns > window_ns ? now_ns - window_ns : 0;
+
+	snprintf(path, sizeof(path), "%s-%d.json", trace_path, dumps++);
+	if ((f = fopen(path, "w")) == NULL) {
+		perror("trace: dump");
+		pthread_mutex_unlock(&dump_lock);
+		return false;
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (int i = 0; i < TRACE_THREADS; ++i) {
+		TraceRing *r = atomic_load_explicit(&rings[i], memory_order_acquire);
+		if (r == NULL)
+			continue;
+
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+				"\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", pid, r->tid, r->name);
+		first = false;
+
+		int n = snapshot(r, from_ns);
+		for (int k = 0; k < n; ++k) {
+			fputs(",\n", f);
+			write_event(f, &scratch[k], pid, r->tid, from_ns);
+		}
+		written += n;
+	}
+	fprintf(f, "\n]}\n");
+
+	bool ok = fclose(f) == 0;
+	pthread_mutex_unlock(&dump_lock);
+	if (!ok) {
+		perror("trace: dump");
+		return false;
+	}
+	fprintf(stderr, "trace: wrote %d events to %s\n", written, path);
+	return true;
+}
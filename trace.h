@@ -0,0 +1,109 @@
+/** TRACE
+ *
+ * Flight recorder for the pipeline threads. Every registered thread owns a
+ * fixed ring of timestamped events (stage begin / end and instant marks
+ * such as xruns, dropped blocks and idle switches) which it overwrites
+ * continuously. Display modes are fixed at compile time, so the idle gate
+ * is the only mode switch there is to mark. Recording is a clock read and
+ * a 16-byte store, with no locks and no allocation.
+ *
+ * On request (from a signal handler, a missed deadline or directly) the
+ * last `seconds` of every ring are written as Chrome trace JSON, which
+ * chrome://tracing and ui.perfetto.dev open as a timeline per thread. The
+ * file is written by a background thread of normal priority, so the
+ * real-time threads keep running while it is written. Requests that are
+ * not forced are ignored within `seconds` of the previous dump, so a run
+ * of missed deadlines gives one file rather than one per frame. The
+ * background thread has a ring of its own, so every dump leaves a mark.
+ *
+ * Each ring has one writer. As in a seqlock, the writer claims a slot and
+ * fences before it overwrites it, so the dumper, which reads without
+ * stopping the writer, can drop any entry that may have been overwritten
+ * while it was copying it.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "perfstat.h"
+#include "pipeline.h"
+
+#define TRACE_EVENTS 8192    // events per thread, a power of two
+#define TRACE_THREADS 8      // threads that can register a ring
+
+
+/* Instant marks. Stage begin / end events use `PerfStage`. */
+typedef enum {
+	MARK_XRUN,           // arg: ALSA error code
+	MARK_DROPPED,        // arg: blocks dropped so far
+	MARK_IDLE,           // mode switch, arg: 1 going idle, 0 waking up
+	MARK_DEADLINE,       // arg: capture to display time in us
+	MARK_DUMP,           // a dump was written, on the thread writing it
+	TRACE_MARKS
+} TraceMark;
+
+
+/* Data structures. */
+typedef struct {
+	uint64_t ns;            // CLOCK_MONOTONIC
+	uint32_t arg;
+	uint8_t name;           // PerfStage for 'B' / 'E', TraceMark for 'i'
+	char phase;             // 'B', 'E' or 'i', as in the trace format
+} TraceEvent;
+
+typedef struct {
+	_Atomic uint64_t head;     // events written so far
+	_Atomic uint64_t claimed;  // events started, one ahead of `head` during a write
+	char name[16];
+	int tid;                // thread id in the trace
+	TraceEvent events[TRACE_EVENTS];
+} TraceRing;
+
+
+/* The calling thread's ring, NULL if it did not register. */
+extern _Thread_local TraceRing *trace_ring;
+
+
+/** Append one event to the calling thread's ring. */
+static inline void trace_record(char phase, int name, uint32_t arg) {
+	TraceRing *r = trace_ring;
+
+	if (r == NULL)
+		return;
+	uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	TraceEvent *e = &r->events[head & (TRACE_EVENTS - 1)];
+
+	/* Claim the slot before overwriting it; see `snapshot`. */
+	atomic_store_explicit(&r->claimed, head + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	e->ns = monotonic_ns();
+	e->arg = arg;
+	e->name = name;
+	e->phase = phase;
+	atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+static inline void trace_begin(PerfStage stage) {
+	trace_record('B', stage, 0);
+}
+
+static inline void trace_end(PerfStage stage) {
+	trace_record('E', stage, 0);
+}
+
+static inline void trace_mark(TraceMark mark, uint32_t arg) {
+	trace_record('i', mark, arg);
+}
+
+
+/* Function declarations. */
+bool trace_init(const char *path, float seconds);
+void trace_shutdown();
+bool trace_thread(const char *name);
+void trace_request_dump(bool always);
+bool trace_dump();
+
+#endif
@@ -9,154 +9,881 @@
 /* Define global variables. */
 struct RGBLedMatrixOptions options;
 struct RGBLedMatrix *matrix;
-struct LedCanvas *canvas;
+Display *display;
 int width, height;
 snd_pcm_t *capture_handle;
 snd_pcm_hw_params_t *hw_params;
+int block_size = N;
 kiss_fftr_cfg fftr_cfg;
-float *history;
+Decimator decimator;
+View views[] = LAYOUT_VIEWS;
+Layout layout;
+uint8_t spectrogram_palette[SPECTROGRAM_LEVELS][3];
 float *bins;
-PointHistory *envelope;
-PointHistory *histogram_values;
+int bins_size;
+int fft_bins;  // spectrum bins computed, N_NYQUIST unless the FFT is pruned
+SpectrumShm *spectrum_shm;
+Weighting weighting = {
+	.curve = WEIGHTING_CURVE,
+	.emphasis_db = PRE_EMPHASIS_DB,
+	.emphasis_hz = PRE_EMPHASIS_HZ,
+	.mains_hz = MAINS_HZ,
+	.mains_harmonics = MAINS_HARMONICS,
+	.notch_width_hz = NOTCH_WIDTH_HZ,
+};
+OnsetDetector onset;
+WelchAverager welch;
+Agc agc;
+IdleGate idle_gate;
+uint64_t stats_since_ns;
+uint64_t stats_frames;
+PerfCounters perf_counters[3];  // main (analysis), capture and render threads
+PerfCounters *capture_perf = &perf_counters[0];
+PerfCounters *analysis_perf = &perf_counters[0];
+PerfCounters *render_perf = &perf_counters[0];
+LatencyProbe latency_probe;
+bool probe_latency;  // --latency: synthetic source and headless sink
+bool pipeline_threads = PIPELINE_THREADS;
+BlockQueue capture_queue;
+FrameExchange frame_exchange;
+volatile sig_atomic_t running = 1;
 
 
 int main(int argc, char *argv[]) {
 	// Install SIGINT handler.
 	signal(SIGINT, sigint_handler);
 
-	char *device = AUDIO_DEVICE;
+	/* `--autotune` measures the block size afresh, caches it and exits, so
+	 * it can run offline without the panel or the sound card. */
+	bool autotune_only = argc > 1 && strcmp(argv[1], "--autotune") == 0;
+	if (AUTOTUNE || autotune_only)
+		block_size = autotune_block_size(N, FS, DECIMATION, AUTOTUNE_RANGE,
+				AUTOTUNE_CACHE, autotune_only);
+	if (autotune_only)
+		return 0;
+	if (AUTOTUNE)
+		fprintf(stderr, "Block size: %d samples.\n", block_size);
 
-	kiss_fft_scalar in[N];
-	kiss_fft_cpx out[N_NYQUIST];
+	/* `--render IN OUT` renders an audio file to a video file as fast as
+	 * possible, without the panel or the sound card. */
+	bool offline = argc > 1 && strcmp(argv[1], "--render") == 0;
+	if (offline && argc != 4) {
+		printf("Usage: %s --render AUDIO VIDEO\n", argv[0]);
+		exit(1);
+	}
+
+	/* `--latency [BLOCK [single|threaded]]` measures the time from sound
+	 * to pixels with synthetic bursts and a headless sink, without the
+	 * panel or the sound card. */
+	probe_latency = argc > 1 && strcmp(argv[1], "--latency") == 0;
+	if (probe_latency) {
+		if (argc > 2)
+			block_size = atoi(argv[2]);
+		if (argc > 3)
+			pipeline_threads = strcmp(argv[3], "single") != 0;
+		if (argc > 4 || (argc > 3 && strcmp(argv[3], "single") != 0 &&
+					strcmp(argv[3], "threaded") != 0) ||
+				block_size <= 0 || block_size % (2 * DECIMATION) != 0) {
+			printf("Usage: %s --latency [BLOCK [single|threaded]]\n"
+					"BLOCK must be a multiple of %d.\n", argv[0], 2 * DECIMATION);
+			exit(1);
+		}
+		if (!latency_probe_init(&latency_probe, FS, block_size, LATENCY_INTERVAL,
+					LATENCY_IMPULSES))
+			exit(1);
+	}
+
+	char *device = AUDIO_DEVICE;
 
 	memset(&options, 0, sizeof(options));
 	options.rows = MATRIX_ROWS;
 	options.cols = MATRIX_COLS;
 	options.chain_length = 1;
 
-	/* This supports all the led commandline options. Try --led-help */
-	matrix = led_matrix_create_from_options(&options, &argc, &argv);
-	if (matrix == NULL)
-		return 1;
+	/* Draw on the local matrix, stream frames to a remote panel driver
+	 * (see vmatrix_rx.c) or, offline, write them to a video file. Only the
+	 * first needs a matrix here. */
+	if (offline) {
+		display = file_display_create(argv[3], options.cols * options.chain_length,
+				options.rows, OFFLINE_SCALE, FS, block_size);
+	} else if (probe_latency) {
+		display = latency_display_create(&latency_probe,
+				options.cols * options.chain_length, options.rows);
+	} else if (REMOTE_SINK[0] == '\0') {
+		/* This supports all the led commandline options. Try --led-help */
+		matrix = led_matrix_create_from_options(&options, &argc, &argv);
+		if (matrix == NULL)
+			return 1;
+		display = led_display_create(matrix);
+	} else {
+		display = remote_display_create(REMOTE_SINK,
+				options.cols * options.chain_length, options.rows);
+	}
+	if (display == NULL) {
+		printf("Error creating display.\n");
+		exit(1);
+	}
 
-	/* Configure ALSA for audio! */
-	int err;
-	short buf[N];
+	/* Configure ALSA for audio! Offline, the audio comes from a file, and
+	 * the latency probe makes its own. */
+	if (!offline && !probe_latency) {
+		int err;
 
-	err = snd_pcm_open(&capture_handle, device, SND_PCM_STREAM_CAPTURE, 0);
-	if (err < 0) {
-		fprintf(stderr, "cannot open audio device %s (%s)\n", device,
-				snd_strerror (err));
+		err = snd_pcm_open(&capture_handle, device, SND_PCM_STREAM_CAPTURE, 0);
+		if (err < 0) {
+			fprintf(stderr, "cannot open audio device %s (%s)\n", device,
+					snd_strerror (err));
+			exit(1);
+		}
+
+		// Configure ALSA hardware parameters.
+		alsa_config_hw_params();
+
+		snd_pcm_hw_params_free(hw_params);
+
+		err = snd_pcm_prepare(capture_handle);
+		if (err < 0) {
+			fprintf(stderr, "cannot prepare audio interface (%s)\n",
+					snd_strerror(err));
+			exit(1);
+		}
+	}
+
+	width = display->width;
+	height = display->height;
+	if (offline)
+		fprintf(stderr, "Size: %dx%d. Rendering %s to %s\n",
+				width, height, argv[2], argv[3]);
+	else if (probe_latency)
+		fprintf(stderr, "Size: %dx%d. Measuring latency, %d bursts %.1f s apart\n",
+				width, height, LATENCY_IMPULSES, LATENCY_INTERVAL);
+	else if (matrix != NULL)
+		fprintf(stderr, "Size: %dx%d. Hardware gpio mapping: %s\n",
+				width, height, options.hardware_mapping);
+	else
+		fprintf(stderr, "Size: %dx%d. Streaming to %s\n",
+				width, height, REMOTE_SINK);
+
+	/* Place the views and allocate their history and column state. */
+	if (!layout_init(&layout, views, sizeof(views) / sizeof(views[0]),
+				width, height)) {
+		printf("Error setting up display layout.\n");
 		exit(1);
 	}
-	
-	// Configure ALSA hardware parameters.
-	alsa_config_hw_params();
 
-	snd_pcm_hw_params_free(hw_params);
+	spectrogram_palette_init();
+	render_kernels_select(&layout);
 
-	err = snd_pcm_prepare(capture_handle);
-	if (err < 0) {
-		fprintf(stderr, "cannot prepare audio interface (%s)\n",
-				snd_strerror(err));
+	/* Allocate the shared binned amplitudes, enough for every view. */
+	bins_size = layout.bins_size;
+	if (bins_size > FFT_SIZE / 2) {
+		printf("Display layout needs more bins than the FFT provides.\n");
 		exit(1);
 	}
 
-	/* We use double-buffering: we have two buffers for the RGB matrix
-	 * that we swap on each update. 
-	 */
-	canvas = led_matrix_create_offscreen_canvas(matrix);
+	/* The views read FFT bins 1 to bins_size; put the latency bursts in
+	 * the middle of that band. */
+	if (probe_latency)
+		latency_probe_set_tone(&latency_probe, (bins_size / 2) * (double) FS / block_size);
+	if ((bins = calloc(bins_size, sizeof(float))) == NULL) {
+		printf("Error allocating memory for binned amplitude array.\n");
+		exit(1);
+	}
+
+	/* Use the plan generated at build time when there is one. */
+	if ((fftr_cfg = fftr_plan_alloc(FFT_SIZE)) == NULL) {
+		printf("Error allocating memory for FFT.\n");
+		exit(1);
+	}
 
-	led_canvas_get_size(canvas, &width, &height);
-	fprintf(stderr, "Size: %dx%d. Hardware gpio mapping: %s\n",
-			width, height, options.hardware_mapping);
+	/* Decimate before the FFT: the same frequency resolution from
+	 * DECIMATION times fewer points. */
+	if (DECIMATION > 1 &&
+			!decimator_init(&decimator, DECIMATION, DECIMATION_TAPS, block_size)) {
+		printf("Error allocating memory for decimator.\n");
+		exit(1);
+	}
 
-	/* Allocate memory for 2-D history array. */
-	if ((history = calloc(width * height, sizeof(float))) == NULL) {
-		printf("Error allocating memory for history array.\n");
+	/* Build the per-bin gain table once; it is only rebuilt if the FFT
+	 * size or sampling rate change. */
+	if (weighting_enabled(&weighting) && !weighting_update(&weighting, FFT_SIZE, FFT_RATE)) {
+		printf("Error allocating memory for weighting curve.\n");
 		exit(1);
 	}
 
-	/* Allocate array for creating amplitude envelope. */
-	if ((envelope = calloc(width, sizeof(PointHistory))) == NULL) {
-		printf("Error allocating memory for envelope array.\n");
+	/* Idle while silent for IDLE_HOLD seconds. */
+	idle_gate_init(&idle_gate, IDLE_OPEN_RMS, IDLE_CLOSE_RMS,
+			IDLE_HOLD * FS / block_size);
+
+	/* Unless the whole spectrum is published, nothing but the onset flux
+	 * reads the bins above the views and the beat band. With FFT_PRUNE the
+	 * FFT skips them, and the onset flux covers the computed bins only. */
+	fft_bins = N_NYQUIST;
+	bool publish = SHM_PUBLISH && !offline;
+	if (FFT_PRUNE && !publish) {
+		int kmax = bins_size > BEAT_MAX_HZ / FREQ_RES ? bins_size : BEAT_MAX_HZ / FREQ_RES;
+		if (kmax + 1 < fft_bins)
+			fft_bins = kmax + 1;
+	}
+
+	/* Onset and beat detection run on every spectrum; the beat band
+	 * covers the bins up to BEAT_MAX_HZ. */
+	if (!onset_init(&onset, fft_bins, BEAT_MAX_HZ / FREQ_RES + 1,
+				ONSET_SENSITIVITY, ONSET_REFRACTORY)) {
+		printf("Error allocating memory for onset detector.\n");
 		exit(1);
 	}
 
-	/* Allocate array for storing histogram value history. */
-	if ((histogram_values = calloc(width, sizeof(PointHistory))) == NULL) {
-		printf("Error allocating memory for histogram_values array.\n");
+	/* Steady the displayed levels by averaging the power spectrum; the
+	 * onsets above still see every frame as it is. */
+	if (WELCH_FRAMES > 1 && !welch_init(&welch, fft_bins, WELCH_FRAMES)) {
+		printf("Error allocating memory for spectrum averaging.\n");
 		exit(1);
 	}
 
-	if ((fftr_cfg = kiss_fftr_alloc(N, 0, NULL, NULL)) == NULL) {
-		printf("Error allocating memory for FFT.\n");
+	/* Follow the room's level with the display range. The gain moves
+	 * 1 - 1/e of the way to a new level in AGC_TIME. */
+	float frame_rate = (float) FS / block_size;
+	if (AGC && !agc_init(&agc, AGC_WINDOW * frame_rate, AGC_QUANTILE, AGC_TARGET,
+				AGC_MIN_GAIN, AGC_MAX_GAIN, 1 - expf(-1 / (AGC_TIME * frame_rate)))) {
+		printf("Error allocating memory for gain control.\n");
 		exit(1);
 	}
 
-	/* FFT + RGB update loop. */
-	for (;;) {
-		
-		// Read from sound card.
-		if ((err = snd_pcm_readi(capture_handle, buf, N)) != N) {
-			fprintf(stderr, "read from audio device failed (%s)\n",
-					snd_strerror(err));
+	/* Publish every spectrum to shared memory so that other local
+	 * processes can use it without opening the sound card. */
+	if (publish) {
+		spectrum_shm = spectrum_shm_create(SHM_NAME, N_NYQUIST, SHM_SLOTS,
+				FFT_RATE, FFT_SIZE);
+		if (spectrum_shm == NULL) {
+			printf("Error creating shared-memory spectrum ring.\n");
 			exit(1);
 		}
-		for (int g = 0; g < N; ++g) in[g] = (kiss_fft_scalar) buf[g];
+	}
+
+	/* Real-time profile: keep every page resident so the loop never
+	 * faults. Scheduling and affinity are set per thread below. */
+	if (RT_PROFILE && !offline) {
+		rt_lock_memory();
+		rt_prefault(bins, bins_size * sizeof(float));
+		if (WELCH_FRAMES > 1)
+			rt_prefault(welch.ring, (size_t) WELCH_FRAMES * fft_bins * sizeof(float));
+		if (AGC)
+			rt_prefault(agc.ring, (size_t) agc.window * AGC_BUCKETS * sizeof(uint16_t));
+		for (int i = 0; i < layout.n_views; ++i) {
+			View *v = &layout.views[i];
+			if (v->bins)
+				rt_prefault(v->bins, v->size * sizeof(float));
+			if (v->history)
+				rt_prefault(v->history, (size_t) (v->zoom + 1) *
+						(v->width + 1) * v->height * sizeof(SpectrogramLevel));
+			if (v->columns)
+				rt_prefault(v->columns->level,
+						COLUMN_ARRAYS * v->columns->stride * sizeof(float));
+		}
+	}
+
+	/* Record the pipeline threads, for a dump on SIGUSR1 or when a block
+	 * reaches the display late. */
+	if (TRACE && !offline) {
+		if (!trace_init(TRACE_PATH, TRACE_SECONDS)) {
+			printf("Error starting the trace recorder.\n");
+			exit(1);
+		}
+		signal(SIGUSR1, sigusr1_handler);
+	}
+
+	/* Count this thread's stages; pipeline threads open their own. */
+	if (PERF_COUNTERS)
+		perf_counters_open(&perf_counters[0]);
+
+	if (offline)
+		render_file(argv[2]);
+	else if (pipeline_threads)
+		run_threaded();
+	else
+		run_single_threaded();
+
+	if (probe_latency) {
+		char config[128];
+		if (!pipeline_threads)
+			snprintf(config, sizeof(config), "block %d, single thread", block_size);
+		else if (RENDER_FPS > 0)
+			snprintf(config, sizeof(config), "block %d, threaded, %d fps", block_size, RENDER_FPS);
+		else
+			snprintf(config, sizeof(config), "block %d, threaded", block_size);
+		latency_probe_report(&latency_probe, config);
+	}
+
+	clean_up();
+	return 0;
+}
+
+
+/** Capture, analyze and render one block at a time on this thread. */
+void run_single_threaded() {
+	short buf[block_size];
+
+	if (RT_PROFILE) {
+		rt_configure_thread("vmatrix", RT_ANALYSIS_PRIO, RT_ANALYSIS_CPU);
+		rt_prefault_stack();
+	}
+	if (TRACE)
+		trace_thread("vmatrix");
+
+	while (running) {
+		if (!capture_block(buf))
+			break;
+		uint64_t timestamp_ns = monotonic_ns();
+		if (!gate_block(buf))
+			continue;
+		uint32_t events = analyze_block(buf, bins);
+		update_views(bins);
+		render_frame(1, BEAT_FLASH && (events & BEAT_EVENT));
+		check_deadline(timestamp_ns);
+	}
+}
+
+
+/** Run capture and render on their own threads and analysis on this one.
+ * Capture keeps reading while a frame is being drawn, and a slow frame
+ * only costs a dropped block instead of an ALSA overrun. */
+void run_threaded() {
+	pthread_t capture_tid, render_tid;
+	short buf[block_size];
+	uint64_t timestamp_ns;
+	uint32_t events;
+
+	if (!block_queue_init(&capture_queue, CAPTURE_QUEUE, block_size) ||
+			!frame_exchange_init(&frame_exchange, bins_size)) {
+		printf("Error allocating memory for pipeline buffers.\n");
+		exit(1);
+	}
+	if (RT_PROFILE)
+		rt_prefault(capture_queue.data, CAPTURE_QUEUE * block_size * sizeof(short));
+
+	if (pthread_create(&capture_tid, NULL, capture_thread, NULL) != 0 ||
+			pthread_create(&render_tid, NULL, render_thread, NULL) != 0) {
+		printf("Error starting pipeline threads.\n");
+		exit(1);
+	}
+
+	if (RT_PROFILE) {
+		rt_configure_thread("vm-analysis", RT_ANALYSIS_PRIO, RT_ANALYSIS_CPU);
+		rt_prefault_stack();
+	}
+	if (TRACE)
+		trace_thread("vm-analysis");
+
+	while (block_queue_pop(&capture_queue, buf, &timestamp_ns)) {
+		if (!gate_block(buf))
+			continue;
+		events = analyze_block(buf, bins);
+		frame_exchange_put(&frame_exchange, bins, events, timestamp_ns);
+	}
+
+	frame_exchange_close(&frame_exchange);
+	pthread_join(capture_tid, NULL);
+	pthread_join(render_tid, NULL);
+
+	if (capture_queue.dropped > 0)
+		fprintf(stderr, "Dropped %llu audio blocks.\n",
+				(unsigned long long) capture_queue.dropped);
+
+	block_queue_destroy(&capture_queue);
+	frame_exchange_destroy(&frame_exchange);
+}
+
+
+/** Capture stage: read blocks from the sound card into the queue. */
+void *capture_thread(void *arg) {
+	short buf[block_size];
+
+	if (RT_PROFILE) {
+		rt_configure_thread("vm-capture", RT_CAPTURE_PRIO, RT_CAPTURE_CPU);
+		rt_prefault_stack();
+	}
+	if (PERF_COUNTERS) {
+		perf_counters_open(&perf_counters[1]);
+		capture_perf = &perf_counters[1];
+	}
+	if (TRACE)
+		trace_thread("vm-capture");
+
+	while (running && capture_block(buf)) {
+		uint64_t dropped = capture_queue.dropped;
+		block_queue_push(&capture_queue, buf, monotonic_ns());
+		if (TRACE && capture_queue.dropped != dropped)
+			trace_mark(MARK_DROPPED, capture_queue.dropped);
+	}
+
+	block_queue_close(&capture_queue);
+	return NULL;
+}
+
+
+/** Render stage: fold each new analysis frame into the views and draw.
+ *
+ * With RENDER_FPS set, frames are drawn on a fixed clock rather than once
+ * per spectrum, and the views are interpolated between the last two
+ * spectra using their capture timestamps. Motion then looks smooth at the
+ * display rate without shortening N. Otherwise every spectrum is drawn
+ * once as it arrives.
+ *
+ * Either way nothing is drawn while no new spectra arrive, e.g. while the
+ * silence gate is closed; the panel holds the last frame. */
+void *render_thread(void *arg) {
+	float *frame;
+	uint64_t seq = 0, drawn = 0;
+	uint64_t timestamp_ns = 0;
+	uint32_t events = 0;
+	bool beat = false;
+	bool settled = false;
+	RenderClock clock;
+
+	if ((frame = calloc(bins_size, sizeof(float))) == NULL) {
+		printf("Error allocating memory for render frame.\n");
+		exit(1);
+	}
+
+	if (RT_PROFILE) {
+		rt_configure_thread("vm-render", RT_RENDER_PRIO, RT_RENDER_CPU);
+		rt_prefault_stack();
+	}
+	if (PERF_COUNTERS) {
+		perf_counters_open(&perf_counters[2]);
+		render_perf = &perf_counters[2];
+	}
+	if (TRACE)
+		trace_thread("vm-render");
+
+	if (RENDER_FPS <= 0) {
+		while (frame_exchange_wait(&frame_exchange, frame, &events, &seq, &timestamp_ns)) {
+			update_views(frame);
+			render_frame(1, BEAT_FLASH && (events & BEAT_EVENT));
+			check_deadline(timestamp_ns);
+		}
+		free(frame);
+		return NULL;
+	}
+
+	uint64_t tick_ns = 1000000000ull / RENDER_FPS;
+	uint64_t next_ns = monotonic_ns();
+	render_clock_init(&clock, 1e9f * block_size / FS);
+
+	while (settled
+			? frame_exchange_wait(&frame_exchange, frame, &events, &seq, &timestamp_ns)
+			: frame_exchange_poll(&frame_exchange, frame, &events, &seq, &timestamp_ns)) {
+		/* A beat stays lit until the next spectrum arrives. */
+		bool fresh = seq != drawn;
+		if (fresh) {
+			update_views(frame);
+			render_clock_frame(&clock, timestamp_ns);
+			beat = BEAT_FLASH && (events & BEAT_EVENT);
+			drawn = seq;
+			if (settled)
+				next_ns = monotonic_ns();
+		}
+
+		/* One frame behind the newest spectrum, or up to one ahead of it
+		 * when extrapolating. */
+		float t = render_clock_phase(&clock, monotonic_ns());
+		render_frame(RENDER_EXTRAPOLATE ? 1 + t : t, beat);
+		if (fresh)
+			check_deadline(timestamp_ns);
+
+		/* Once the views have reached the newest spectrum nothing moves
+		 * until the next one, so wait for it instead of redrawing. */
+		if ((settled = t >= 1))
+			continue;
+
+		/* Sleep until the next tick; after a stall, restart the clock
+		 * instead of drawing a burst of catch-up frames. */
+		next_ns += tick_ns;
+		uint64_t now_ns = monotonic_ns();
+		if (next_ns < now_ns)
+			next_ns = now_ns;
+		struct timespec ts = {
+			.tv_sec = next_ns / 1000000000ull,
+			.tv_nsec = next_ns % 1000000000ull,
+		};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+	}
+
+	free(frame);
+	return NULL;
+}
+
+
+/** Offline mode: analyse and render the audio file at `path` as fast as
+ * the CPU allows, writing one video frame per block.
+ *
+ * The audio is taken OFFLINE_CHUNK blocks at a time. Their spectra are
+ * computed on every core, then onsets, averaging and the views advance
+ * through them in order on this thread, exactly as they would live. The
+ * silence gate is bypassed so that the video keeps its timeline. */
+void render_file(const char *path) {
+	int n_threads = OFFLINE_THREADS > 0 ? OFFLINE_THREADS : sysconf(_SC_NPROCESSORS_ONLN);
+	OfflineWorker workers[n_threads > 0 ? n_threads : 1];
+	pthread_t tids[n_threads > 0 ? n_threads : 1];
+	uint64_t frames = 0;
+	AudioFile af;
+
+	if (n_threads < 1)
+		n_threads = 1;
+	if (!audio_file_open(&af, path, FS))
+		exit(1);
+	if (af.rate != FS) {
+		printf("Error: %s is sampled at %d Hz; vmatrix analyses at %d Hz.\n",
+				path, af.rate, FS);
+		exit(1);
+	}
+
+	/* The chunk is preceded by the last block of the previous one, which
+	 * primes the decimators. */
+	short *audio = calloc((size_t) (OFFLINE_CHUNK + 1) * block_size, sizeof(short));
+	float *spectra = malloc((size_t) OFFLINE_CHUNK * N_NYQUIST * sizeof(float));
+	if (audio == NULL || spectra == NULL) {
+		printf("Error allocating memory for offline rendering.\n");
+		exit(1);
+	}
+	for (int i = 0; i < n_threads; ++i) {
+		memset(&workers[i], 0, sizeof(OfflineWorker));
+		if ((workers[i].cfg = fftr_plan_alloc(FFT_SIZE)) == NULL ||
+				(DECIMATION > 1 && !decimator_init(&workers[i].decimator,
+						DECIMATION, DECIMATION_TAPS, block_size))) {
+			printf("Error allocating memory for offline analysis.\n");
+			exit(1);
+		}
+	}
+
+	uint64_t start_ns = monotonic_ns();
+	while (running) {
+		short *chunk = audio + block_size;
+		int n = audio_file_read(&af, chunk, OFFLINE_CHUNK * block_size);
+		if (n <= 0)
+			break;
+
+		/* Pad the last block with silence. */
+		int blocks = (n + block_size - 1) / block_size;
+		memset(chunk + n, 0, ((size_t) blocks * block_size - n) * sizeof(short));
+
+		int used = 0;
+		for (int i = 0; i < n_threads; ++i) {
+			int first = (int64_t) blocks * i / n_threads;
+			int last = (int64_t) blocks * (i + 1) / n_threads;
+			workers[i].audio = chunk + (size_t) first * block_size;
+			workers[i].spectra = spectra + (size_t) first * N_NYQUIST;
+			workers[i].blocks = last - first;
+			if (workers[i].blocks == 0)
+				continue;
+			if (pthread_create(&tids[used++], NULL, offline_worker, &workers[i]) != 0) {
+				printf("Error starting offline analysis threads.\n");
+				exit(1);
+			}
+		}
+		for (int i = 0; i < used; ++i)
+			pthread_join(tids[i], NULL);
+
+		for (int b = 0; b < blocks; ++b) {
+			stage_begin(analysis_perf, STAGE_BINNING);
+			uint32_t events = analyze_spectrum(spectra + (size_t) b * N_NYQUIST, bins);
+			stage_end(analysis_perf, STAGE_BINNING);
+			update_views(bins);
+			render_frame(1, BEAT_FLASH && (events & BEAT_EVENT));
+		}
+		frames += blocks;
+
+		memcpy(audio, chunk + (size_t) (blocks - 1) * block_size, block_size * sizeof(short));
+	}
+
+	double secs = (monotonic_ns() - start_ns) / 1e9;
+	double audio_secs = (double) frames * block_size / FS;
+	fprintf(stderr, "Rendered %llu frames (%.1f s of audio) in %.1f s, %.0fx real time, "
+			"on %d threads.\n", (unsigned long long) frames, audio_secs, secs,
+			secs > 0 ? audio_secs / secs : 0, n_threads);
+
+	for (int i = 0; i < n_threads; ++i) {
+		free(workers[i].cfg);
+		decimator_free(&workers[i].decimator);
+	}
+	free(audio);
+	free(spectra);
+	audio_file_close(&af);
+}
+
+
+/** Offline analysis thread: the spectra of one worker's run of blocks. */
+void *offline_worker(void *arg) {
+	OfflineWorker *w = arg;
+
+	/* Rebuild the decimator history from the preceding block, so the
+	 * result does not depend on where the chunk was split. */
+	if (DECIMATION > 1) {
+		kiss_fft_scalar discard[FFT_SIZE];
+		decimator_process(&w->decimator, w->audio - block_size, discard);
+	}
+
+	for (int b = 0; b < w->blocks; ++b)
+		block_spectrum(w->audio + (size_t) b * block_size,
+				w->spectra + (size_t) b * N_NYQUIST, w->cfg, &w->decimator);
+	return NULL;
+}
+
+
+/** Read one block of `block_size` samples. Returns false if the read was interrupted
+ * by shutdown. */
+bool capture_block(short *buf) {
+	int err;
+
+	if (probe_latency)
+		return latency_probe_read(&latency_probe, buf);
+
+	stage_begin(capture_perf, STAGE_CAPTURE);
+	err = snd_pcm_readi(capture_handle, buf, block_size);
+	stage_end(capture_perf, STAGE_CAPTURE);
+
+	if (err != block_size) {
+		if (!running)
+			return false;
+		fprintf(stderr, "read from audio device failed (%s)\n",
+				snd_strerror(err));
+		/* Keep the moments before the overrun. */
+		if (TRACE) {
+			trace_mark(MARK_XRUN, -err);
+			trace_dump();
+		}
+		exit(1);
+	}
+	return true;
+}
+
+
+/** Analysis stage: run the silence gate on one block. Returns false if
+ * the block should be skipped. Also prints the periodic stats line. */
+bool gate_block(const short *buf) {
+	bool was_open = idle_gate.open;
+	bool open = !IDLE_GATE || idle_gate_update(&idle_gate, buf, block_size);
+
+	if (TRACE && IDLE_GATE && open != was_open)
+		trace_mark(MARK_IDLE, !open);
+
+	print_stats();
+	return open;
+}
+
+
+/** Start timing `stage` on this thread, for the counters and the trace. */
+void stage_begin(PerfCounters *pc, PerfStage stage) {
+	if (PERF_COUNTERS)
+		perf_stage_begin(pc);
+	if (TRACE)
+		trace_begin(stage);
+}
+
+
+/** End `stage` on this thread. */
+void stage_end(PerfCounters *pc, PerfStage stage) {
+	if (PERF_COUNTERS)
+		perf_stage_end(pc, stage);
+	if (TRACE)
+		trace_end(stage);
+}
+
+
+/** Called once the spectrum of the block captured at `timestamp_ns` is on
+ * the display. Past TRACE_DEADLINE block periods, mark the miss and ask
+ * for a trace dump. */
+void check_deadline(uint64_t timestamp_ns) {
+	if (!TRACE || TRACE_DEADLINE <= 0)
+		return;
+
+	uint64_t late_ns = monotonic_ns() - timestamp_ns;
+	if (late_ns > TRACE_DEADLINE * 1e9 * block_size / FS) {
+		trace_mark(MARK_DEADLINE, late_ns / 1000);
+		trace_request_dump(false);
+	}
+}
+
+
+/** Analysis stage: FFT one block, detect onsets and bin it into the
+ * `bins_size` bins shared by all views. Returns the onset / beat events. */
+uint32_t analyze_block(const short *buf, float *binarr) {
+	/* When publishing, the amplitudes are written straight into the
+	 * shared ring. */
+	float local_amplitudes[N_NYQUIST];
+	float *amplitudes = local_amplitudes;
+	if (spectrum_shm)
+		amplitudes = spectrum_shm_begin(spectrum_shm);
+
+	stage_begin(analysis_perf, STAGE_FFT);
+	block_spectrum(buf, amplitudes, fftr_cfg, &decimator);
+	stage_end(analysis_perf, STAGE_FFT);
+
+	stage_begin(analysis_perf, STAGE_BINNING);
+	uint32_t events = analyze_spectrum(amplitudes, binarr);
+	stage_end(analysis_perf, STAGE_BINNING);
+	return events;
+}
+
+
+/** Analysis stage, first half: the weighted magnitude spectrum of one
+ * block, `fft_bins` values into `amplitudes`. It keeps no state but the
+ * decimator history, so blocks can be analysed on several threads, each
+ * with its own `cfg` and `dec`. */
+void block_spectrum(const short *buf, float *amplitudes, kiss_fftr_cfg cfg, Decimator *dec) {
+	kiss_fft_scalar in[FFT_SIZE];
+	kiss_fft_cpx out[N_NYQUIST];
+
+	if (DECIMATION > 1)
+		decimator_process(dec, buf, in);
+	else
+		for (int g = 0; g < block_size; ++g) in[g] = (kiss_fft_scalar) buf[g];
 
-		/* Do FFT on buffered data. */
-		kiss_fftr(fftr_cfg, in, out);
+	/* Do FFT on buffered data. */
+	if (fft_bins < N_NYQUIST)
+		kiss_fftr_pruned(cfg, in, out, 0, fft_bins - 1);
+	else
+		kiss_fftr(cfg, in, out);
 
-		/* Compute amplitude of frequency components. Since FFT has
-		 * symmetric magnitude, we only need to take absolute value
-		 * of the real component to get the amplitude. */
-		float amplitudes[N_NYQUIST];
-		for (int k = 0; k < N_NYQUIST; ++k) {
-			amplitudes[k] = abs(out[k].r);
+	/* Compute amplitude of frequency components. Since FFT has
+	 * symmetric magnitude, we only need to take absolute value
+	 * of the real component to get the amplitude. Scaling by
+	 * DECIMATION keeps levels independent of the FFT length. */
+	for (int k = 0; k < fft_bins; ++k) {
+		amplitudes[k] = fabsf(out[k].r * DECIMATION);
+	}
+
+	/* Apply weighting, pre-emphasis and notches as one multiply per bin.
+	 * The gain table was built at startup, so this only reads it. */
+	if (weighting.gains != NULL && weighting_update(&weighting, FFT_SIZE, FFT_RATE))
+		weighting_apply(&weighting, amplitudes, fft_bins);
+}
+
+
+/** Analysis stage, second half: detect onsets, publish, average and bin
+ * one spectrum from `block_spectrum`, in block order. Returns the onset /
+ * beat events. */
+uint32_t analyze_spectrum(float *amplitudes, float *binarr) {
+	uint32_t events = onset_update(&onset, amplitudes);
+
+	if (spectrum_shm)
+		spectrum_shm_commit(spectrum_shm, events);
+
+	/* Average the power over the last WELCH_FRAMES spectra. Published
+	 * spectra and onsets use the frame as it is. */
+	float averaged[fft_bins];
+	if (WELCH_FRAMES > 1) {
+		welch_update(&welch, amplitudes, averaged);
+		amplitudes = averaged;
+	}
+
+	/* One binning pass serves every view; coarser views average these
+	 * bins when they are drawn (see `view_bins`). */
+	bin_amplitudes(amplitudes, binarr, bins_size, 1);
+
+	/* Scale to the room; the window sees the levels before the gain. */
+	if (AGC) {
+		float gain = agc_update(&agc, binarr, bins_size);
+		for (int x = 0; x < bins_size; ++x)
+			binarr[x] *= gain;
+	}
+
+	stats_frames++;
+	return events;
+}
+
+
+/** Print a line of analysis statistics every STATS_INTERVAL seconds. */
+void print_stats() {
+	uint64_t now = monotonic_ns();
+	double secs = (now - stats_since_ns) / 1e9;
+
+	if (STATS_INTERVAL <= 0)
+		return;
+	if (stats_since_ns == 0) {
+		stats_since_ns = now;
+		return;
+	}
+	if (secs < STATS_INTERVAL)
+		return;
+
+	fprintf(stderr, "stats: %.1f fps, %llu onsets, %llu beats, %.0f BPM, "
+			"idle %.0f s, gain %.2f\n",
+			stats_frames / secs, (unsigned long long) onset.onsets,
+			(unsigned long long) onset.beats,
+			onset_bpm(&onset, (float) FS / block_size),
+			(double) idle_gate.idle_blocks * block_size / FS,
+			AGC ? agc.gain : 1.0);
+
+	stats_frames = 0;
+	stats_since_ns = now;
+}
+
+
+/** Render stage: fold one frame of binned amplitudes into the state of
+ * every view. */
+void update_views(float *binarr) {
+	for (int i = 0; i < layout.n_views; ++i) {
+		View *v = &layout.views[i];
+		float *values = view_bins(v, binarr);
+
+		switch (v->mode) {
+			case HISTOGRAM_W_ENVELOPE:
+				histogram_update(v, values, 0.35, 0.65, false);
+				break;
+			case SCROLLING_SPECTROGRAM:
+				scrolling_spectrogram_update(v, values);
+				break;
+			default:  // HISTOGRAM, HISTOGRAM_HOLLOW or unexpected value
+				histogram_update(v, values, 0.5, 0.5, true);
+				break;
 		}
+	}
+}
+
+
+/** Render stage: draw every view `t` of the way from the previous
+ * spectrum to the newest one and swap the frame in. `beat` flashes the
+ * envelopes. */
+void render_frame(float t, bool beat) {
+	stage_begin(render_perf, STAGE_RENDER);
+
+	/* Update matrix display, compositing every view into the frame. */
+	display_clear(display);
+	for (int i = 0; i < layout.n_views; ++i) {
+		View *v = &layout.views[i];
 
-		/* Update matrix display. */
-		led_canvas_clear(canvas);
-		switch (DISPLAY_MODE) {
+		switch (v->mode) {
 			case HISTOGRAM_HOLLOW:
-				bins = bin_amplitudes(amplitudes, width, 1);
-				histogram(bins, 0.5, 0.5, false, false, true);
+				histogram(v, t, false, false, beat);
 				break;
 			case HISTOGRAM_W_ENVELOPE:
-				bins = bin_amplitudes(amplitudes, width, 1);
-				histogram(bins, 0.35, 0.65, true, true, false);
+				histogram(v, t, true, true, beat);
 				break;
 			case SCROLLING_SPECTROGRAM:
-				bins = bin_amplitudes(amplitudes, height, 2);
-				scrolling_spectrogram(bins);
+				scrolling_spectrogram(v, t);
 				break;
 			default:  // HISTOGRAM or unexpected value
-				bins = bin_amplitudes(amplitudes, width, 1);
-				histogram(bins, 0.5, 0.5, false, true, true);
+				histogram(v, t, false, true, beat);
 				break;
 		}
-		
-		/* Now, we swap the canvas. We give swap_on_vsync the buffer we
-		 * just have drawn into, and wait until the next vsync happens.
-		 * we get back the unused buffer to which we'll draw in the next
-		 * iteration.
-		 */
-		canvas = led_matrix_swap_on_vsync(matrix, canvas);
-
 	}
 
-	clean_up();
-	return 0;
+	stage_end(render_perf, STAGE_RENDER);
+	stage_begin(render_perf, STAGE_PRESENT);
+
+	/* Hand the frame to the sink. The LED sink swaps it in on the next
+	 * vsync and waits for it. */
+	display_present(display);
+
+	stage_end(render_perf, STAGE_PRESENT);
 }
 
 
-/** Bin amplitudes from FFT. */
-float *bin_amplitudes(float *amplitudes, int size, int bin_size) {
-	/* Allocate memory for binned amplitudes array. The `fmaxf` function
-	 * finds the maximum of two floats.
-	 */
-	float *binarr;
+/** Bin amplitudes from FFT into `binarr`, which holds `size` values. */
+void bin_amplitudes(float *amplitudes, float *binarr, int size, int bin_size) {
 	float scaling = 1.0 / (FS / 3.0);
 	
 	if (size < 0) {
@@ -169,15 +896,10 @@ float *bin_amplitudes(float *amplitudes, int size, int bin_size) {
 		exit(1);
 	}
 
-	if (size * bin_size > N) {
+	if (size * bin_size > FFT_SIZE) {
 		printf("Size * bin size cannot be greater than FFT size.\n");
 	}
 
-	if ((binarr = calloc(size, sizeof(float))) == NULL) {
-		printf("Error allocating memory for binned amplitude array.\n");
-		exit(1);
-	}
-
 	/* First several amplitudes are too low too hear, so we offset the
 	 * amplitude indexing to skip them. */
 	for (int x = 0; x < size; ++x) {
@@ -187,145 +909,316 @@ float *bin_amplitudes(float *amplitudes, int size, int bin_size) {
 			sum += amplitudes[offset_idx + b] / (float) bin_size;
 		binarr[x] = sum * scaling;
 	}
+}
+
+
+/** Precompute the spectrogram colormap for every history level. */
+void spectrogram_palette_init() {
+	/* Amplitude boundaries (cap amplitude above and below these values). */
+	float s_min = SPECTROGRAM_MIN;
+	float s_max = SPECTROGRAM_MAX;
+
+	for (int q = 0; q < SPECTROGRAM_LEVELS; ++q) {
+		int bin = s_min + (s_max - s_min) * q / (SPECTROGRAM_LEVELS - 1);
+
+		// Normalize bin value.
+		float normalized = (bin - s_min) / (s_max - s_min);
+		float inverted = ((1.0 - normalized) / 0.2);
+		int group = (int) inverted;
+		int scale = (int) (255 * (inverted - group));
+
+		// Map `group` and `scale` to RGB colormap.
+		int r = 0, g = 0, b = 0;
+		switch (group) {
+			case 0:
+				r = 255; g = scale; b = 0; break;
+			case 1:
+				r = 255 - scale; g = 255; b = 0; break;
+			case 2:
+				r = 0; g = 255; b = scale; break;
+			case 3:
+				r = 0; g = 255 - scale; b = 255; break;
+			case 4:
+				r = 0; g = 0; b = 255 - scale; break;
+			case 5:
+				r = 0; g = 0; b = 0; break;
+		}
+
+		spectrogram_palette[q][0] = r;
+		spectrogram_palette[q][1] = g;
+		spectrogram_palette[q][2] = b;
+	}
+}
+
+
+/** Quantize one binned amplitude to a spectrogram history level. */
+SpectrogramLevel spectrogram_quantize(float value) {
+	float normalized = (value - SPECTROGRAM_MIN) / (SPECTROGRAM_MAX - SPECTROGRAM_MIN);
 
-	/* Return allocated pointer to binned amplitude values. */
-	return binarr;
+	if (normalized <= 0)
+		return 0;
+	if (normalized >= 1)
+		return SPECTROGRAM_LEVELS - 1;
+	return normalized * (SPECTROGRAM_LEVELS - 1) + 0.5f;
 }
 
 
-/** A horizontally scrolling spectrogram. */
-void scrolling_spectrogram(float *binarr) {
+/** Pool two history levels into one for the next octave. Levels are
+ * linear in amplitude, so this matches pooling the amplitudes. A mean
+ * that falls halfway rounds up if `round_up`; callers alternate it so
+ * that every octave is not biased half a level brighter than the last. */
+static inline SpectrogramLevel spectrogram_pool(SpectrogramLevel a, SpectrogramLevel b, int round_up) {
+	if (SPECTROGRAM_POOL_MAX)
+		return a > b ? a : b;
+	return (a + b + round_up) / 2;
+}
+
+
+/** Shift the newest spectrum into the scrolling history of view `v`, and
+ * into every octave up to `v->zoom` that it completes a column of. */
+void scrolling_spectrogram_update(View *v, float *binarr) {
 	/* Shift 2D history array. Since this 2D array is actually contiguous in
-	 * memory, we can just shift all elements back by `width` (dropping the
-	 * last `width` elements). Then, we can add our new `binarr` array to
-	 * the front of the `history` array.
+	 * memory, we can just move all columns back by `height` entries
+	 * (dropping the oldest column). Then, we quantize our new `binarr`
+	 * array into the front of the `history` array. One column more than
+	 * the view is wide is kept for scrolling by part of a column.
 	 */
-	int d = height;  // dimension that binning is over
+	SpectrogramLevel *history = v->history;
+	int d = v->height;  // dimension that binning is over
+	size_t octave = (size_t) (v->width + 1) * d;
 
-	for (int i = (width * height) - 1; i >= d; --i)
-		history[i] = history[i - d];
+	memmove(history + d, history, v->width * d * sizeof(SpectrogramLevel));
 
 	for (int i = 0; i < d; ++i)
-		history[i] = binarr[i];
+		history[i] = spectrogram_quantize(binarr[i]);
+	v->spectra++;
 
-	/* Amplitude boundaries (cap amplitude above and below these values). */
-	float s_min = 0.0;
-	float s_max = 400.0;
+	/* Every 2^k spectra, the two newest columns of octave k - 1 are both
+	 * complete and are pooled into a new column of octave k. Means round
+	 * halves up on every other column of an octave. */
+	for (int k = 1; k <= v->zoom && v->spectra % (1ull << k) == 0; ++k) {
+		SpectrogramLevel *below = history + (k - 1) * octave;
+		SpectrogramLevel *level = below + octave;
+		int round_up = (v->spectra >> k) & 1;
+
+		memmove(level + d, level, v->width * d * sizeof(SpectrogramLevel));
+		for (int i = 0; i < d; ++i)
+			level[i] = spectrogram_pool(below[i], below[d + i], round_up);
+	}
+}
+
+
+/** A horizontally scrolling spectrogram in view `v`, scrolled `t` of a
+ * column (0 to 1) from the previous spectrum towards the newest one.
+ *
+ * Zoomed out, a column of the octave shown is completed every 2^zoom
+ * spectra, and the view scrolls through it over as many spectra. */
+void scrolling_spectrogram(View *v, float t) {
+	if (v->zoom > 0) {
+		uint64_t span = 1ull << v->zoom;
+		t = ((v->spectra & (span - 1)) + (t < 1 ? t : 1)) / span;
+	}
+	v->kernels->spectrogram(v, t);
+}
+
+
+/** The spectrogram loops for a `width` x `height` view. Always inlined,
+ * so that the specialized instances below get constant trip counts. The
+ * view lies inside the panel (see `layout_init`), so pixels are written
+ * without clipping. */
+static inline __attribute__((always_inline))
+void scrolling_spectrogram_kernel(View *v, float t, const int width, const int height) {
+	SpectrogramLevel *history = v->history + (size_t) v->zoom * (width + 1) * height;
+	int stride = 3 * display->width;
+	uint8_t *origin = display->pixels + 3 * (v->y * display->width + v->x);
 
 	/* Since history is a contiguous 1D array (but we're using it to store
-	 * 2D information) we can just incrementally step through it and we will
-	 * retrieve the appropriate values for each column of the scrolling
-	 * spectrogram matrix (we use the nested loops to get `x` and `y` for
-	 * drawing to the canvas, but we use `ctr` to keep track of our index in
-	 * `history` array). */
-	int ctr = 0;
+	 * 2D information), column `age` (0 is the newest spectrum) starts at
+	 * `age * height`. Between spectra, every pixel blends the levels of
+	 * the two columns that are passing through it. At `t` = 1 the newest
+	 * column sits on the right edge. */
+	float shift = 1 - (t < 1 ? t : 1);
 	for (int x = width - 1; x >= 0; --x) {
+		float age = (width - 1 - x) + shift;
+		int a0 = (int) age;
+		float frac = age - a0;
+		SpectrogramLevel *col = history + a0 * height;
+
 		for (int y = height - 1; y >= 0; --y) {
-			int bin = history[ctr];
-
-			// Normalize bin value.
-			if (bin > s_max) bin = s_max;  // cap value of bin
-			float normalized = (bin - s_min) / (s_max - s_min);
-			float inverted = ((1.0 - normalized) / 0.2);
-			int group = (int) inverted;
-			int scale = (int) (255 * (inverted - group));
-
-			// Map `group` and `scale` to RGB colormap.
-			int r = 0, g = 0, b = 0;
-			switch (group) {
-				case 0:
-					r = 255; g = scale; b = 0; break;
-				case 1:
-					r = 255 - scale; g = 255; b = 0; break;
-				case 2:
-					r = 0; g = 255; b = scale; break;
-				case 3:
-					r = 0; g = 255 - scale; b = 255; break;
-				case 4:
-					r = 0; g = 0; b = 255 - scale; break;
-				case 5:
-					r = 0; g = 0; b = 0; break;
-			}
+			int q = col[height - 1 - y];
+			if (frac > 0 && a0 < width)
+				q += (int) ((col[height + height - 1 - y] - q) * frac);
 
-			led_canvas_set_pixel(canvas, x, y, r, g, b);
-			ctr ++;
+			const uint8_t *rgb = spectrogram_palette[q];
+			uint8_t *p = origin + y * stride + 3 * x;
+			p[0] = rgb[0];
+			p[1] = rgb[1];
+			p[2] = rgb[2];
 		}
 	}
 }
 
 
-/** A basic spectrogram histogram visualization.
+/** Blend the newest spectrum into the histogram columns of view `v` and
+ * update their envelope. */
+void histogram_update(View *v, float *binarr, float old_weight, float new_weight, bool show_bottom_row) {
+	float scaling = 1.0 / 20.0;
+
+	/* Smooth every column and update its envelope in one SIMD pass each.
+	 * When the bottom row is hidden, offset by one so that the pixels do
+	 * not show when there is no sound. */
+	column_smooth(v->columns, binarr, scaling, v->height, old_weight,
+			new_weight, show_bottom_row ? 0 : 1);
+	column_envelope(v->columns, v->height, ENVELOPE_CTR);
+}
+
+
+/** A basic spectrogram histogram visualization in view `v`, with the bars
+ * `t` of the way from the previous spectrum to the newest one.
  *
- * If `fill_hist` is true, fill each histogram bin vertically.
+ * If `fill_hist` is true, fill each histogram bin vertically. If `beat` is
+ * true, the envelope is drawn white for this frame.
  */
-void histogram(float *binarr, float old_weight, float new_weight, bool show_envelope, bool fill_hist, bool show_bottom_row) {
-	int y;
-	float scaling = 1.0 / 20.0;
+void histogram(View *v, float t, bool show_envelope, bool fill_hist, bool beat) {
+	v->kernels->histogram(v, t, show_envelope, fill_hist, beat);
+}
 
-	for (int x = 0; x < width; ++x) {
-		y = (height) - (int) (binarr[x] * scaling);
-		if (y <= 0) y = 0;
 
-		// Take weighted average of old and current histogram bin.
-		histogram_values[x].y = (int)((float)histogram_values[x].y * old_weight + (float)y * new_weight);
+/** The histogram loops for a `width` x `height` view, inlined into the
+ * specialized instances like `scrolling_spectrogram_kernel`. Rows off
+ * the view (a level of `height` means silence) are not drawn. */
+static inline __attribute__((always_inline))
+void histogram_kernel(View *v, float t, bool show_envelope, bool fill_hist, bool beat,
+		const int width, const int height) {
+	ColumnState *columns = v->columns;
+	int stride = 3 * display->width;
+	uint8_t *origin = display->pixels + 3 * (v->y * display->width + v->x);
+
+	column_interpolate(columns, t);
+
+	// Render the histogram
+	for (int x = 0; x < width; ++x) {
+		int level = (int) columns->shown[x];
 
-		if (show_bottom_row == false) {
-			histogram_values[x].y += 1; // add one to offset the pixels so they don't show when there is no sound
-		}
-		
-		// Render the histogram
 		if (fill_hist == true) {
-			for (int yy = height; yy >= histogram_values[x].y; --yy) {
-				int r = yy;
-				int g = 0;
-				int b = yy * 7;
-				led_canvas_set_pixel(canvas, x, yy, r, g, b);
+			for (int yy = height - 1; yy >= level && yy >= 0; --yy) {
+				uint8_t *p = origin + yy * stride + 3 * x;
+				p[0] = yy;
+				p[1] = 0;
+				p[2] = yy * 7;
 			}
-		} else {
-			led_canvas_set_pixel(canvas, x, histogram_values[x].y, 0xff, 0, 0xff);
-		}
-
-		// Update amplitude envelope.
-		if (y < envelope[x].y) envelope[x].y = y;
-		if (envelope[x].y > height) envelope[x].y = height;
-		if (envelope[x].counter-- < 0) {
-			envelope[x].y ++;
-			envelope[x].counter = ENVELOPE_CTR;
+		} else if (level >= 0 && level < height) {
+			uint8_t *p = origin + level * stride + 3 * x;
+			p[0] = 0xff;
+			p[1] = 0;
+			p[2] = 0xff;
 		}
 	}
 
 	// Update envelope pixels on canvas.
 	if (show_envelope) {
 		for (int i = 0; i < width; ++i) {
+			int y = (int) columns->envelope[i];
+
 			/* Don't set the pixels if they are on the bottom row of
 			 * the canvas (this makes things look bad). */
-			if (envelope[i].y != height) {
-				int r = 0xcc;
-				int g = 0;
-				int b = 0x66;
-				led_canvas_set_pixel(canvas, i, envelope[i].y, r, g, b);
+			if (y >= 0 && y < height) {
+				uint8_t *p = origin + y * stride + 3 * i;
+				p[0] = beat ? 0xff : 0xcc;
+				p[1] = beat ? 0xff : 0;
+				p[2] = beat ? 0xff : 0x66;
 			}
 		}
 	}
 }
 
 
+/* One instance of the render loops per size in RENDER_GEOMETRIES, and a
+ * generic one taking the size from the view. */
+#define RENDER_KERNEL_FUNCTIONS(W, H) \
+	static void scrolling_spectrogram_##W##x##H(View *v, float t) { \
+		scrolling_spectrogram_kernel(v, t, W, H); \
+	} \
+	static void histogram_##W##x##H(View *v, float t, bool show_envelope, bool fill_hist, bool beat) { \
+		histogram_kernel(v, t, show_envelope, fill_hist, beat, W, H); \
+	}
+#define RENDER_KERNEL_ENTRY(W, H) \
+	{ W, H, scrolling_spectrogram_##W##x##H, histogram_##W##x##H },
+
+RENDER_GEOMETRIES(RENDER_KERNEL_FUNCTIONS)
+
+static void scrolling_spectrogram_generic(View *v, float t) {
+	scrolling_spectrogram_kernel(v, t, v->width, v->height);
+}
+
+static void histogram_generic(View *v, float t, bool show_envelope, bool fill_hist, bool beat) {
+	histogram_kernel(v, t, show_envelope, fill_hist, beat, v->width, v->height);
+}
+
+static const RenderKernels render_kernels[] = {
+	RENDER_GEOMETRIES(RENDER_KERNEL_ENTRY)
+	{ 0, 0, scrolling_spectrogram_generic, histogram_generic }
+};
+
+
+/** Pick the render loops for every view once, by its size. */
+void render_kernels_select(Layout *l) {
+	int n = sizeof(render_kernels) / sizeof(render_kernels[0]);
+
+	for (int i = 0; i < l->n_views; ++i) {
+		View *v = &l->views[i];
+		const RenderKernels *k = &render_kernels[n - 1];
+
+		for (int j = 0; j < n - 1; ++j)
+			if (render_kernels[j].width == v->width && render_kernels[j].height == v->height)
+				k = &render_kernels[j];
+		v->kernels = k;
+		if (k->width == 0)
+			fprintf(stderr, "View %d: %dx%d, generic render loops.\n", i, v->width, v->height);
+	}
+}
+
+
 /** Clean up at the end of the process. */
 void clean_up() {
 	// Close sound device.
-	snd_pcm_close(capture_handle);
+	if (capture_handle != NULL)
+		snd_pcm_close(capture_handle);
 
 	// Clean up kissfft.
 	free(fftr_cfg);			
 	kiss_fft_cleanup();
+	decimator_free(&decimator);
+
+	// Remove shared-memory spectrum ring.
+	spectrum_shm_close(spectrum_shm);
 
 	// Free allocated arrays.
-	free(history);
-	free(envelope);
+	weighting_free(&weighting);
+	onset_free(&onset);
+	welch_free(&welch);
+	agc_free(&agc);
+	latency_probe_free(&latency_probe);
+	layout_free(&layout);
 	free(bins);
 
+	if (PERF_COUNTERS) {
+		for (int i = 0; i < 3; ++i)
+			perf_counters_close(&perf_counters[i]);
+		perf_report(perf_counters, 3, onset.frames);
+	}
+	if (TRACE)
+		trace_shutdown();
+
+	if (idle_gate.closings > 0)
+		fprintf(stderr, "Idle for %.0f s in %llu periods of silence.\n",
+				(double) idle_gate.idle_blocks * block_size / FS,
+				(unsigned long long) idle_gate.closings);
+
 	// Reset matrix display.
-	led_matrix_delete(matrix);
+	display_destroy(display);
+	if (matrix != NULL)
+		led_matrix_delete(matrix);
 
 	printf("Goodbye.\n");
 }
@@ -383,8 +1276,15 @@ void alsa_config_hw_params() {
 }
 
 
-/** Handle SIGINT, i.e. CTRL+C. */
+/** Handle SIGINT, i.e. CTRL+C. The pipeline winds down within one block
+ * and `main` cleans up. */
 void sigint_handler(int signo) {
 	printf("Caught SIGINT. Cleaning up...\n");
-	clean_up();
+	running = 0;
+}
+
+
+/** Handle SIGUSR1: dump the trace of the last TRACE_SECONDS. */
+void sigusr1_handler(int signo) {
+	trace_request_dump(true);
 }
@@ -1,12 +1,34 @@
 #include <alsa/asoundlib.h>
+#include <errno.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include "led-matrix-c.h"
+#include "agc.h"
+#include "audiofile.h"
+#include "autotune.h"
+#include "columns.h"
+#include "decimate.h"
+#include "display.h"
+#include "display_led.h"
+#include "fftr_plans.h"
+#include "gate.h"
 #include "kiss_fftr.h"
+#include "latency.h"
+#include "layout.h"
+#include "onset.h"
+#include "perfstat.h"
+#include "pipeline.h"
+#include "rt.h"
+#include "spectrum_shm.h"
+#include "trace.h"
+#include "weighting.h"
+#include "welch.h"
 
 
 /* Definitions. */
@@ -14,41 +36,157 @@
 #define MATRIX_ROWS 32       // matrix default row count
 #define MATRIX_COLS 64       // matrix default column count
 #define FS 44100             // Hz, audio sampling rate
-#define N 1600               // audio sample buffer size 
+#define N 1600               // audio sample buffer size (requested, see AUTOTUNE)
+#define AUTOTUNE 0           // use the block size near N with the fastest FFT on this CPU
+#define AUTOTUNE_RANGE 0.15  // fraction of N the block size may move by
+#define AUTOTUNE_CACHE "/var/cache/vmatrix-autotune"  // "" to measure on every start
+#define DECIMATION 1         // decimate by this before the FFT (N must be a multiple), 1 for none
+#define DECIMATION_TAPS 12   // anti-aliasing filter taps per decimation phase
 #define ENVELOPE_CTR 1       // number of clicks envelope falls
+#define SPECTROGRAM_MIN 0.0  // binned amplitude drawn black by the spectrogram
+#define SPECTROGRAM_MAX 400.0  // binned amplitude at the top of its colormap
+#define SPECTROGRAM_POOL_MAX 1  // zoomed-out spectrogram columns show the loudest of their spectra, 0 the mean
+#define WELCH_FRAMES 1       // average the power over this many spectra before binning, 1 for none
+#define AGC 1                // scale the binned levels to the room instead of by fixed factors
+#define AGC_QUANTILE 0.95    // fraction of recent binned levels that stay below AGC_TARGET
+#define AGC_TARGET 300.0     // binned level AGC_QUANTILE is scaled to (cf. SPECTROGRAM_MAX)
+#define AGC_WINDOW 10.0      // seconds of binned levels the quantile is taken over
+#define AGC_TIME 2.0         // seconds for the gain to move most of the way to a new level
+#define AGC_MIN_GAIN 0.1
+#define AGC_MAX_GAIN 30.0    // limits how far a quiet room is turned up
+#define SHM_PUBLISH 1        // publish spectra to shared memory for other processes
+#define FFT_PRUNE 0          // without SHM_PUBLISH, compute only the bins the views and beat band read
+#define SHM_NAME "/vmatrix-spectrum"  // POSIX shared-memory object name
+#define SHM_SLOTS 16         // spectrum frames kept in the shared-memory ring
+#define REMOTE_SINK ""       // e.g. "udp:10.0.0.2:7000" or "unix:/tmp/vmatrix.sock"; "" draws locally
+#define BEAT_MAX_HZ 150      // upper edge of the band used for beat detection
+#define ONSET_SENSITIVITY 1.5  // onset threshold in std. deviations above the mean
+#define ONSET_REFRACTORY 4   // minimum frames between onsets / beats
+#define BEAT_FLASH 1         // flash the envelope on beats
+#define STATS_INTERVAL 10    // seconds between stats lines, 0 for none
+#define PERF_COUNTERS 0      // count cycles, instructions and misses per stage, reported on exit
+#define TRACE 0              // flight recorder, dumped on SIGUSR1 or a missed deadline (see trace.h)
+#define TRACE_SECONDS 5.0    // seconds of history per dump
+#define TRACE_DEADLINE 2.0   // block periods from capture to display before a dump, 0 for none
+#define TRACE_PATH "/tmp/vmatrix-trace"  // dumps go to TRACE_PATH-<n>.json
+#define IDLE_GATE 1          // skip analysis and redraws while the room is silent
+#define IDLE_OPEN_RMS 50     // block RMS, in sample units, that wakes the display
+#define IDLE_CLOSE_RMS 25    // block RMS below which a block counts as silent
+#define IDLE_HOLD 3.0        // seconds of silence before going idle
+#define PIPELINE_THREADS 1   // run capture, analysis and render on their own threads
+#define RENDER_FPS 60        // threaded: redraw rate, interpolating between spectra; 0 draws each spectrum once
+#define RENDER_EXTRAPOLATE 0 // histograms run ahead of the latest spectrum instead of one frame behind it
+#define CAPTURE_QUEUE 4      // audio blocks buffered between capture and analysis
+#define OFFLINE_THREADS 0    // --render: analysis threads, 0 for one per CPU
+#define OFFLINE_CHUNK 512    // --render: blocks analysed in parallel per pass
+#define OFFLINE_SCALE 8      // --render: video pixels per panel pixel, each way
+#define LATENCY_INTERVAL 1.0 // --latency: seconds between bursts
+#define LATENCY_IMPULSES 30  // --latency: bursts per measurement
 
 
-/* Computed definitions. */
-#define N_NYQUIST (N / 2) + 1      // Nyquist frequency
-#define FREQ_RES (FS / N)          // FFT frequency resolution
-#define MIN_FREQ FREQ_RES          // freq. of lowest FFT bin
-#define MAX_FREQ FREQ_RES * (N/2)  // freq. of highest FFT bin
+/* Frequency-response shaping applied to the FFT magnitudes (see
+ * weighting.h). Everything off leaves the spectrum untouched. */
+#define WEIGHTING_CURVE WEIGHT_NONE  // WEIGHT_NONE, WEIGHT_A or WEIGHT_C
+#define PRE_EMPHASIS_DB 0.0          // dB per octave above PRE_EMPHASIS_HZ
+#define PRE_EMPHASIS_HZ 1000.0
+#define MAINS_HZ 0                   // 50 or 60 to notch mains hum, 0 for none
+#define MAINS_HARMONICS 3            // notches at MAINS_HZ and its harmonics
+#define NOTCH_WIDTH_HZ 20.0
+
+
+/* Real-time profile (opt-in). A priority of 0 keeps normal scheduling and
+ * a CPU of -1 leaves affinity alone. Core 3 is left to the refresh thread
+ * of the matrix library. */
+#define RT_PROFILE 0
+#define RT_CAPTURE_PRIO 70
+#define RT_CAPTURE_CPU 1
+#define RT_ANALYSIS_PRIO 60
+#define RT_ANALYSIS_CPU 2
+#define RT_RENDER_PRIO 50
+#define RT_RENDER_CPU 2
+
+
+/* Computed definitions. `block_size` is N unless autotuned. */
+#define FFT_SIZE (block_size / DECIMATION) // FFT points per block
+#define FFT_RATE (FS / DECIMATION)         // Hz, sampling rate seen by the FFT
+#define N_NYQUIST ((FFT_SIZE / 2) + 1)     // Nyquist frequency
+#define FREQ_RES (FS / block_size)         // FFT frequency resolution
+#define MIN_FREQ FREQ_RES                  // freq. of lowest FFT bin
+#define MAX_FREQ FREQ_RES * (FFT_SIZE/2)   // freq. of highest FFT bin
 #define MAX_FREQ_CAP 16000         // max freq. for visualization purposes
 
 
-/* Display modes. */
-enum {
-	HISTOGRAM,
-	HISTOGRAM_HOLLOW,
-	HISTOGRAM_W_ENVELOPE,
-	SCROLLING_SPECTROGRAM
-} DisplayModes;
+#if N % (2 * DECIMATION) != 0
+#error "N must be a multiple of DECIMATION and leave an even FFT size"
+#endif
+
+
+/* Display mode (see layout.h). */
 #define DISPLAY_MODE HISTOGRAM_HOLLOW
 
+/* Views composited into each frame, with their position and size in
+ * panel pixels. A width or height of 0 extends the view to the panel edge.
+ * All views share one FFT and one binning pass per frame. For example, a
+ * spectrogram on the left and an enveloped histogram on the right:
+ *   { { .mode = SCROLLING_SPECTROGRAM, .width = 32 },
+ *     { .mode = HISTOGRAM_W_ENVELOPE, .x = 32 } }
+ * A spectrogram with `.zoom = k` pools 2^k spectra per column: at N = 1600
+ * a 64 column view spans 2.3 s at zoom 0, 74 s at 5 and 79 min at 11.
+ */
+#define LAYOUT_VIEWS { { .mode = DISPLAY_MODE } }
+
+/* View sizes (width, height) whose render loops are compiled with fixed
+ * bounds, so they can be unrolled and vectorized: a 32x64 panel, a 64x64
+ * panel, four chained 32x64 panels and the halves of a split 32x64 panel.
+ * Views of other sizes use the generic loops. */
+#define RENDER_GEOMETRIES(X) X(64, 32) X(64, 64) X(256, 32) X(32, 32)
+
 
 /* Data structures. */
 typedef struct {
-	int y;
-	int counter;  // keep track of # of iterations passed
-} PointHistory;
+	kiss_fftr_cfg cfg;
+	Decimator decimator;
+	const short *audio;     // first block, preceded by the block before it
+	float *spectra;         // N_NYQUIST amplitudes per block
+	int blocks;
+} OfflineWorker;
+
+typedef struct RenderKernels {
+	int width, height;      // 0 for the generic loops
+	void (*spectrogram)(View *v, float t);
+	void (*histogram)(View *v, float t, bool show_envelope, bool fill_hist, bool beat);
+} RenderKernels;
 
 
 /* Function declarations. */
 void sigint_handler(int signo);
+void sigusr1_handler(int signo);
 void clean_up();
 void alsa_config_hw_params();
 double linspace(double min, double max, int i, int n);
 double logspace(double min, double max, int i, int n);
-float *bin_amplitudes(float *amplitudes, int size, int bin_size);
-void histogram(float *amplitudes, float old_weight, float new_weight, bool show_envelope, bool fill_hist, bool show_bottom_row);
-void scrolling_spectrogram(float *binarr);
+void run_single_threaded();
+void run_threaded();
+void *capture_thread(void *arg);
+void *render_thread(void *arg);
+bool capture_block(short *buf);
+bool gate_block(const short *buf);
+void stage_begin(PerfCounters *pc, PerfStage stage);
+void stage_end(PerfCounters *pc, PerfStage stage);
+void check_deadline(uint64_t timestamp_ns);
+uint32_t analyze_block(const short *buf, float *binarr);
+void block_spectrum(const short *buf, float *amplitudes, kiss_fftr_cfg cfg, Decimator *dec);
+uint32_t analyze_spectrum(float *amplitudes, float *binarr);
+void render_file(const char *path);
+void *offline_worker(void *arg);
+void update_views(float *binarr);
+void render_frame(float t, bool beat);
+void render_kernels_select(Layout *l);
+void print_stats();
+void bin_amplitudes(float *amplitudes, float *binarr, int size, int bin_size);
+void histogram_update(View *v, float *binarr, float old_weight, float new_weight, bool show_bottom_row);
+void histogram(View *v, float t, bool show_envelope, bool fill_hist, bool beat);
+void spectrogram_palette_init();
+SpectrogramLevel spectrogram_quantize(float value);
+void scrolling_spectrogram_update(View *v, float *binarr);
+void scrolling_spectrogram(View *v, float t);
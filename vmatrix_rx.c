@@ -0,0 +1,102 @@
+/** VMATRIX_RX
+ *
+ * Panel driver for a remote vmatrix: receive frames streamed by a vmatrix
+ * built with REMOTE_SINK and draw them on the local RGB LED matrix.
+ *
+ *     vmatrix_rx [--led-options] ADDRESS
+ *     vmatrix_rx --headless WIDTHxHEIGHT ADDRESS
+ *
+ * ADDRESS is "udp::PORT" (any interface), "udp:HOST:PORT" or "unix:PATH".
+ * Headless mode decodes without a panel, for loopback testing on any box.
+ * Bandwidth and latency statistics are printed to stderr.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "display_led.h"
+
+#define MATRIX_ROWS 32       // matrix default row count
+#define MATRIX_COLS 64       // matrix default column count
+
+
+static volatile sig_atomic_t running = 1;
+
+
+/** Handle SIGINT, i.e. CTRL+C. */
+static void sigint_handler(int signo) {
+	running = 0;
+}
+
+
+/** Headless sink: frames are decoded but not shown. */
+static void headless_present(Display *d) {
+}
+
+
+static void headless_destroy(Display *d) {
+	display_free(d);
+}
+
+
+int main(int argc, char *argv[]) {
+	struct RGBLedMatrixOptions options;
+	struct RGBLedMatrix *matrix = NULL;
+	RemoteReceiver *rx;
+	Display *display;
+
+	/* No SA_RESTART, so that a blocked recv returns on CTRL+C. */
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigint_handler;
+	sigaction(SIGINT, &sa, NULL);
+
+	if (argc == 4 && strcmp(argv[1], "--headless") == 0) {
+		int width, height;
+		if (sscanf(argv[2], "%dx%d", &width, &height) != 2 ||
+				(display = display_alloc(width, height)) == NULL) {
+			fprintf(stderr, "Bad display size %s.\n", argv[2]);
+			return 1;
+		}
+		display->present = headless_present;
+		display->destroy = headless_destroy;
+	} else {
+		memset(&options, 0, sizeof(options));
+		options.rows = MATRIX_ROWS;
+		options.cols = MATRIX_COLS;
+		options.chain_length = 1;
+
+		/* This supports all the led commandline options. Try --led-help */
+		matrix = led_matrix_create_from_options(&options, &argc, &argv);
+		if (matrix == NULL)
+			return 1;
+		if ((display = led_display_create(matrix)) == NULL) {
+			printf("Error creating display.\n");
+			return 1;
+		}
+	}
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s [--led-options] ADDRESS\n"
+				"       %s --headless WIDTHxHEIGHT ADDRESS\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	if ((rx = remote_receiver_open(argv[argc - 1])) == NULL)
+		return 1;
+	fprintf(stderr, "Size: %dx%d. Listening on %s\n",
+			display->width, display->height, argv[argc - 1]);
+
+	while (running) {
+		if (remote_receiver_next(rx, display))
+			display_present(display);
+	}
+
+	remote_receiver_close(rx);
+	display_destroy(display);
+	if (matrix != NULL)
+		led_matrix_delete(matrix);
+	printf("Goodbye.\n");
+	return 0;
+}
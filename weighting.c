@@ -0,0 +1,102 @@
+/** WEIGHTING
+ *
+ * Per-bin gain curves and their application to the magnitude array.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "weighting.h"
+
+
+/** Unnormalized A-weighting response (IEC 61672) at `f` Hz. */
+static double a_response(double f) {
+	double f2 = f * f;
+	return (12194.0 * 12194.0 * f2 * f2) /
+		((f2 + 20.6 * 20.6) *
+		 sqrt((f2 + 107.7 * 107.7) * (f2 + 737.9 * 737.9)) *
+		 (f2 + 12194.0 * 12194.0));
+}
+
+
+/** Unnormalized C-weighting response (IEC 61672) at `f` Hz. */
+static double c_response(double f) {
+	double f2 = f * f;
+	return (12194.0 * 12194.0 * f2) /
+		((f2 + 20.6 * 20.6) * (f2 + 12194.0 * 12194.0));
+}
+
+
+/** Combined linear gain of all enabled curves at `f` Hz. */
+static double gain_at(const Weighting *w, double f) {
+	double g = 1.0;
+
+	// Weighting curves are normalized to unity gain at 1 kHz.
+	if (w->curve == WEIGHT_A)
+		g *= a_response(f) / a_response(1000.0);
+	else if (w->curve == WEIGHT_C)
+		g *= c_response(f) / c_response(1000.0);
+
+	if (w->emphasis_db != 0 && f > w->emphasis_hz)
+		g *= pow(10.0, w->emphasis_db * log2(f / w->emphasis_hz) / 20.0);
+
+	// Gaussian band-stops centred on the mains frequency and harmonics.
+	if (w->mains_hz > 0) {
+		double sigma = w->notch_width_hz / 2.0;
+		for (int h = 1; h <= w->mains_harmonics; ++h) {
+			double d = (f - h * w->mains_hz) / sigma;
+			g *= 1.0 - exp(-0.5 * d * d);
+		}
+	}
+
+	return g;
+}
+
+
+bool weighting_enabled(const Weighting *w) {
+	return w->curve != WEIGHT_NONE || w->emphasis_db != 0 || w->mains_hz > 0;
+}
+
+
+/** Rebuild the gain table if `nfft` or `fs` differ from the ones it was
+ * built for. Cheap to call every frame. Returns false on allocation
+ * failure. */
+bool weighting_update(Weighting *w, int nfft, int fs) {
+	if (w->gains != NULL && w->nfft == nfft && w->fs == fs)
+		return true;
+
+	int n_bins = nfft / 2 + 1;
+	float *gains = realloc(w->gains, n_bins * sizeof(float));
+	if (gains == NULL) {
+		fprintf(stderr, "weighting: error allocating gain table.\n");
+		return false;
+	}
+
+	for (int k = 0; k < n_bins; ++k)
+		gains[k] = (float) gain_at(w, (double) k * fs / nfft);
+
+	w->gains = gains;
+	w->n_bins = n_bins;
+	w->nfft = nfft;
+	w->fs = fs;
+	return true;
+}
+
+
+/** Multiply the first `n` of `amplitudes` (at most n_bins) by the gain
+ * table in place. */
+void weighting_apply(const Weighting *w, float *amplitudes, int n) {
+	const float *restrict g = w->gains;
+	float *restrict a = amplitudes;
+
+	if (n > w->n_bins)
+		n = w->n_bins;
+	for (int k = 0; k < n; ++k)
+		a[k] *= g[k];
+}
+
+
+void weighting_free(Weighting *w) {
+	free(w->gains);
+	w->gains = NULL;
+}
@@ -0,0 +1,49 @@
+/** WEIGHTING
+ *
+ * Frequency-response shaping applied directly to the FFT magnitudes: A- or
+ * C-weighting, a pre-emphasis tilt and notches at the mains frequency and
+ * its harmonics.
+ *
+ * All enabled curves are multiplied into one per-bin gain table, so shaping
+ * costs one multiply per bin per frame instead of a time-domain filter per
+ * sample. The table is rebuilt only when the FFT size or sampling rate
+ * changes.
+ */
+
+#ifndef WEIGHTING_H
+#define WEIGHTING_H
+
+#include <stdbool.h>
+
+
+/* Weighting curves. */
+enum {
+	WEIGHT_NONE,
+	WEIGHT_A,
+	WEIGHT_C
+};
+
+
+/* Data structures. */
+typedef struct {
+	int curve;              // WEIGHT_NONE, WEIGHT_A or WEIGHT_C
+	float emphasis_db;      // dB per octave above `emphasis_hz`, 0 for none
+	float emphasis_hz;
+	int mains_hz;           // 50 or 60 to notch hum, 0 for none
+	int mains_harmonics;    // number of harmonics notched, including the fundamental
+	float notch_width_hz;   // width of each notch
+
+	int nfft;               // FFT size the table was built for
+	int fs;                 // sampling rate the table was built for
+	int n_bins;
+	float *gains;           // n_bins linear amplitude gains
+} Weighting;
+
+
+/* Function declarations. */
+bool weighting_enabled(const Weighting *w);
+bool weighting_update(Weighting *w, int nfft, int fs);
+void weighting_apply(const Weighting *w, float *amplitudes, int n);
+void weighting_free(Weighting *w);
+
+#endif
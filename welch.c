@@ -0,0 +1,52 @@
+/** WELCH
+ *
+ * Running power-spectrum average.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "welch.h"
+
+
+bool welch_init(WelchAverager *w, int n_bins, int frames) {
+	memset(w, 0, sizeof(WelchAverager));
+	w->n_bins = n_bins;
+	w->frames = frames > 0 ? frames : 1;
+	w->ring = calloc((size_t) w->frames * n_bins, sizeof(float));
+	w->sum = calloc(n_bins, sizeof(double));
+	return w->ring != NULL && w->sum != NULL;
+}
+
+
+/** Add one frame of `n_bins` magnitudes and write the averaged magnitudes
+ * to `averaged`. Until the window has filled, the average is over the
+ * frames seen so far. */
+void welch_update(WelchAverager *w, const float *amplitudes, float *averaged) {
+	float *row = w->ring + (size_t) w->pos * w->n_bins;
+	bool full = w->filled == w->frames;
+
+	if (!full)
+		w->filled++;
+	double scale = 1.0 / w->filled;
+
+	for (int k = 0; k < w->n_bins; ++k) {
+		float power = amplitudes[k] * amplitudes[k];
+		double sum = w->sum[k] + power - (full ? row[k] : 0);
+		/* Rounding can leave a tiny negative sum after a loud frame
+		 * leaves the window. */
+		w->sum[k] = sum > 0 ? sum : 0;
+		row[k] = power;
+		averaged[k] = sqrtf(w->sum[k] * scale);
+	}
+
+	w->pos = (w->pos + 1) % w->frames;
+}
+
+
+void welch_free(WelchAverager *w) {
+	free(w->ring);
+	free(w->sum);
+	w->ring = NULL;
+	w->sum = NULL;
+}
@@ -0,0 +1,36 @@
+/** WELCH
+ *
+ * Running average of the power spectrum over the last `frames` spectra,
+ * ahead of binning, for steadier levels without extra FFTs. With the
+ * frames themselves being periodogram estimates, this is Welch's method
+ * over consecutive (here non-overlapping) blocks.
+ *
+ * A ring keeps the power of each frame in the window and a running sum
+ * per bin: a new frame adds its power and subtracts the oldest, so the
+ * cost is O(bins) whatever the window length. The output is the square
+ * root of the mean power, in the same units as the input magnitudes.
+ */
+
+#ifndef WELCH_H
+#define WELCH_H
+
+#include <stdbool.h>
+
+
+/* Data structures. */
+typedef struct {
+	int n_bins;
+	int frames;            // window length
+	float *ring;           // `frames` x `n_bins` powers
+	double *sum;           // running sum of the ring, per bin
+	int pos;               // next ring row
+	int filled;            // ring rows in use
+} WelchAverager;
+
+
+/* Function declarations. */
+bool welch_init(WelchAverager *w, int n_bins, int frames);
+void welch_update(WelchAverager *w, const float *amplitudes, float *averaged);
+void welch_free(WelchAverager *w);
+
+#endif